@@ -0,0 +1,185 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "DocumentGenerator.h"
+#include "../../Source/AttributedStringBuilder.h"
+#include "../../Source/Utf8Buffer.h"
+
+namespace
+{
+    const char* const familyNames[] = { "Helvetica", "Times New Roman", "Courier", "Arial",
+                                        "Georgia", "Verdana", "Menlo", "Palatino" };
+
+    // a mix of two, three and four byte UTF-8 sequences
+    const juce_wchar nonAsciiCharacters[] = { 0xe9, 0xfc, 0xdf, 0x3a9, 0x416, 0x20ac, 0x4e2d, 0x1f600 };
+
+    const uint32 palette[] = { 0xff000000, 0xff202020, 0xffc0392b, 0xff2980b9,
+                               0xff27ae60, 0xff8e44ad, 0xffd35400, 0xff7f8c8d };
+
+    static Font createFont (int index)
+    {
+        const int numNames = (int) numElementsInArray (familyNames);
+
+        String family (familyNames[index % numNames]);
+
+        if (index >= numNames)
+            family << ' ' << (index / numNames);
+
+        return Font (family, (float) (10 + (index * 3) % 15), index & (Font::bold | Font::italic | Font::underlined));
+    }
+
+    static juce_wchar createCharacter (Random& random, const DocumentGenerator::Parameters& p)
+    {
+        const double r = random.nextDouble();
+
+        if (r < p.newlineShare)
+            return '\n';
+
+        if (r < p.newlineShare + p.nonAsciiShare)
+        {
+            switch (p.script)
+            {
+                case DocumentGenerator::Script::cyrillic:   return 0x410 + random.nextInt (64);    // the letters of Windows-1251's upper half
+                case DocumentGenerator::Script::cjk:        return 0x4e00 + random.nextInt (0x5200); // CJK Unified Ideographs
+                case DocumentGenerator::Script::mixed:
+                default:                                    return nonAsciiCharacters[random.nextInt ((int) numElementsInArray (nonAsciiCharacters))];
+            }
+        }
+
+        const int letter = random.nextInt (32);
+        return letter < 26 ? (juce_wchar) ('a' + letter) : (juce_wchar) ' ';
+    }
+
+    //==============================================================================
+    // Writes numChars characters, starting at p
+    static void writeRtfText (String::CharPointerType& p, int numChars, int codePage, OutputStream& out)
+    {
+        for (; numChars > 0 && ! p.isEmpty(); --numChars)
+        {
+            const juce_wchar c = p.getAndAdvance();
+
+            switch (c)
+            {
+                case '\\':  out << "\\\\"; break;
+                case '{':   out << "\\{"; break;
+                case '}':   out << "\\}"; break;
+                case '\n':  out << "\\par\n"; break;
+                case '\t':  out << "\\tab "; break;
+
+                default:
+                    if (c < 0x80)
+                    {
+                        out.writeByte ((char) c);
+                    }
+                    else if (codePage == 1251 && c >= 0x410 && c < 0x450)
+                    {
+                        out << "\\'" << String::toHexString ((int) (c - 0x410 + 0xc0));
+                    }
+                    else if (c < 0x10000)
+                    {
+                        out << "\\u" << (int) (int16) c << '?';
+                    }
+                    else
+                    {
+                        const juce_wchar v = c - 0x10000;
+                        out << "\\u" << (int) (int16) (0xd800 + (v >> 10)) << '?'
+                            << "\\u" << (int) (int16) (0xdc00 + (v & 0x3ff)) << '?';
+                    }
+
+                    break;
+            }
+        }
+    }
+}
+
+//==============================================================================
+AttributedString* DocumentGenerator::createAttributedString (const Parameters& p)
+{
+    Random random (p.seed);
+
+    Array<Font> fonts;
+
+    for (int i = 0; i < jmax (1, p.numFonts); ++i)
+        fonts.add (createFont (i));
+
+    ScopedPointer<AttributedString> result (new AttributedString);
+    AttributedStringBuilder builder (*result);
+
+    Utf8Buffer run;
+    int64 numBytes = 0;
+
+    while (numBytes < p.textBytes)
+    {
+        const int length = 1 + random.nextInt (jmax (1, 2 * p.averageRunLength));
+
+        for (int i = 0; i < length; ++i)
+            run.appendCharacter (createCharacter (random, p));
+
+        const Font& font = fonts.getReference (random.nextInt (fonts.size()));
+        const Colour colour (palette[random.nextInt ((int) numElementsInArray (palette))]);
+
+        builder.append (run.getData(), run.getSize(), &font, &colour);
+
+        numBytes += (int64) run.getSize();
+        run.clear();
+    }
+
+    builder.flush();
+    return result.release();
+}
+
+void DocumentGenerator::writeRtf (const AttributedString& attributedString, OutputStream& out, int codePage)
+{
+    StringArray families;
+    Array<Colour> colours;
+
+    for (int i = 0; i < attributedString.getNumAttributes(); ++i)
+    {
+        const AttributedString::Attribute& attr = attributedString.getAttribute (i);
+        families.addIfNotAlreadyThere (attr.font.getTypefaceName());
+        colours.addIfNotAlreadyThere (attr.colour);
+    }
+
+    out << "{\\rtf1\\ansi\\ansicpg" << codePage << "\\deff0\n{\\fonttbl";
+
+    for (int i = 0; i < families.size(); ++i)
+        out << "{\\f" << i << ' ' << families[i] << ";}";
+
+    out << "}\n{\\colortbl;";
+
+    for (auto& c : colours)
+        out << "\\red" << (int) c.getRed() << "\\green" << (int) c.getGreen() << "\\blue" << (int) c.getBlue() << ';';
+
+    out << "}\n";
+
+    const String& text = attributedString.getText();
+    String::CharPointerType p (text.getCharPointer());
+    int index = 0;
+
+    for (int i = 0; i < attributedString.getNumAttributes(); ++i)
+    {
+        const AttributedString::Attribute& attr = attributedString.getAttribute (i);
+        const Font& font = attr.font;
+
+        out << "\\f" << families.indexOf (font.getTypefaceName())
+            << "\\fs" << roundToInt (font.getHeightInPoints() * 2.0f)
+            << (font.isBold()       ? "\\b"  : "\\b0")
+            << (font.isItalic()     ? "\\i"  : "\\i0")
+            << (font.isUnderlined() ? "\\ul" : "\\ul0")
+            << "\\cf" << (colours.indexOf (attr.colour) + 1) << ' ';
+
+        for (; index < attr.range.getStart() && ! p.isEmpty(); ++index)
+            ++p;
+
+        writeRtfText (p, attr.range.getLength(), codePage, out);
+        index = attr.range.getEnd();
+    }
+
+    out << "}\n";
+}
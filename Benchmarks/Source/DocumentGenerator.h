@@ -0,0 +1,49 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/**
+    Creates synthetic documents for the benchmarks.
+
+    The same parameters and seed always produce the same document, so results
+    from different builds can be compared.
+*/
+struct DocumentGenerator
+{
+    /** The characters which nonAsciiShare is made of. */
+    enum class Script
+    {
+        mixed,          // a mix of two, three and four byte UTF-8 sequences
+        cyrillic,       // written to RTF as \'hh escapes in Windows-1251
+        cjk             // written to RTF as \u escapes
+    };
+
+    struct Parameters
+    {
+        int64 textBytes = 1024 * 1024;      // roughly, in UTF-8
+        int averageRunLength = 200;         // in characters
+        double newlineShare = 1.0 / 80.0;   // the share of characters which are newlines
+        int numFonts = 4;                   // distinct family/size/style combinations
+        double nonAsciiShare = 0.0;         // the share of characters outside ASCII
+        Script script = Script::mixed;
+        int64 seed = 1;
+    };
+
+    static AttributedString* createAttributedString (const Parameters& parameters);
+
+    /** Writes an RTF document with the same text and formatting as the string.
+        With the Cyrillic code page (1251), Cyrillic letters are written as \'hh
+        escapes; everything else outside ASCII is always written as \u escapes.
+    */
+    static void writeRtf (const AttributedString& attributedString, OutputStream& out, int codePage = 1252);
+};
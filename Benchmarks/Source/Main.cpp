@@ -0,0 +1,488 @@
+/*
+  ==============================================================================
+
+    This file was auto-generated!
+
+    It contains the basic startup code for a Juce application.
+
+  ==============================================================================
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/AttributedStringSerializer.h"
+#include "../../Source/SerializerStats.h"
+#include "../../Source/AttributedRunTable.h"
+#include "../../Source/AttributedStringXmlWriter.h"
+#include "../../Source/AttributedStringTextWriter.h"
+#include "../../Source/ExportPipeline.h"
+#include "../../Source/ParseArena.h"
+#include "DocumentGenerator.h"
+#include "MemoryStats.h"
+
+#include <iostream>
+
+//==============================================================================
+namespace
+{
+    struct Options
+    {
+        File jsonFile;
+        bool jsonToStdout = false;
+        int64 maxTextBytes = 64 * 1024 * 1024;
+        double minSeconds = 0.5;
+        String filter;
+    };
+
+    struct BenchmarkCase
+    {
+        String name;
+        DocumentGenerator::Parameters parameters;
+    };
+
+    struct Measurement
+    {
+        String operation;
+        int64 numBytes = 0;
+        int64 numStoredBytes = 0;                           // the compressed size, for the compressed formats
+        int numIterations = 0;
+        double medianSeconds = 0, minSeconds = 0;
+        double numAllocations = 0, numBytesAllocated = 0;   // per iteration
+        int64 peakResidentBytes = 0;
+        SerializerStats serializerStats;                     // all iterations, if they're enabled
+    };
+
+    //==============================================================================
+    static int64 parseSize (const String& s)
+    {
+        const juce_wchar suffix = CharacterFunctions::toUpperCase (s.getLastCharacter());
+        const int64 value = s.getLargeIntValue();
+
+        if (suffix == 'K')  return value << 10;
+        if (suffix == 'M')  return value << 20;
+        if (suffix == 'G')  return value << 30;
+
+        return value;
+    }
+
+    static String describeSize (int64 numBytes)
+    {
+        if (numBytes >= (1 << 20) && numBytes % (1 << 20) == 0)  return String (numBytes >> 20) + "M";
+        if (numBytes >= (1 << 10) && numBytes % (1 << 10) == 0)  return String (numBytes >> 10) + "K";
+
+        return String (numBytes);
+    }
+
+    static void printUsage()
+    {
+        std::cout << "Usage: Benchmarks [options]" << std::endl
+                  << std::endl
+                  << "  --json <file>       also write the results as JSON (use - for stdout)" << std::endl
+                  << "  --max-size <size>   skip documents with more text than this, e.g. 512M (default: 64M)" << std::endl
+                  << "  --min-time <secs>   repeat each measurement for at least this long (default: 0.5)" << std::endl
+                  << "  --filter <text>     only run the cases whose names contain the text" << std::endl;
+    }
+
+    static bool parseArguments (const StringArray& args, Options& options)
+    {
+        for (int i = 0; i < args.size(); ++i)
+        {
+            const String& arg = args[i];
+
+            if (i + 1 >= args.size())
+                return false;
+
+            const String value (args[++i]);
+
+            if (arg == "--json")
+            {
+                if (value == "-")
+                    options.jsonToStdout = true;
+                else
+                    options.jsonFile = File::getCurrentWorkingDirectory().getChildFile (value);
+            }
+            else if (arg == "--max-size")   options.maxTextBytes = parseSize (value);
+            else if (arg == "--min-time")   options.minSeconds = value.getDoubleValue();
+            else if (arg == "--filter")     options.filter = value;
+            else                            return false;
+        }
+
+        return true;
+    }
+
+    //==============================================================================
+    // One axis is varied at a time, everything else stays at the defaults of
+    // DocumentGenerator::Parameters (1M of text, runs of 200 characters, ...)
+    static Array<BenchmarkCase> createCases (const Options& options)
+    {
+        Array<BenchmarkCase> cases;
+
+        auto add = [&] (const String& name, const DocumentGenerator::Parameters& p)
+        {
+            if (p.textBytes <= options.maxTextBytes && name.contains (options.filter))
+                cases.add ({ name, p });
+        };
+
+        const int64 sizes[] = { 16 << 10, 256 << 10, 1 << 20, 16 << 20, 64 << 20, 256 << 20 };
+
+        for (auto size : sizes)
+        {
+            DocumentGenerator::Parameters p;
+            p.textBytes = size;
+            add ("size=" + describeSize (size), p);
+        }
+
+        for (auto runLength : { 10, 10000 })
+        {
+            DocumentGenerator::Parameters p;
+            p.averageRunLength = runLength;
+            add ("run-length=" + String (runLength), p);
+        }
+
+        for (auto share : { 0.0, 0.125 })
+        {
+            DocumentGenerator::Parameters p;
+            p.newlineShare = share;
+            add ("newlines=" + String (share), p);
+        }
+
+        for (auto numFonts : { 1, 64, 1024 })
+        {
+            DocumentGenerator::Parameters p;
+            p.numFonts = numFonts;
+            add ("fonts=" + String (numFonts), p);
+        }
+
+        for (auto share : { 0.1, 0.5 })
+        {
+            DocumentGenerator::Parameters p;
+            p.nonAsciiShare = share;
+            add ("non-ascii=" + String (share), p);
+        }
+
+        {
+            DocumentGenerator::Parameters p;
+            p.nonAsciiShare = 0.8;
+            p.script = DocumentGenerator::Script::cyrillic;
+            add ("script=cyrillic", p);
+
+            p.script = DocumentGenerator::Script::cjk;
+            add ("script=cjk", p);
+        }
+
+        return cases;
+    }
+
+    //==============================================================================
+    template <typename Operation>
+    static Measurement measure (const String& name, int64 numBytes, const Options& options, Operation&& operation)
+    {
+        const int maxIterations = 1000;
+
+        MemoryStats::resetPeakResidentBytes();
+        const MemoryStats::Snapshot before (MemoryStats::getAllocations());
+        SerializerStats::resetTotals();
+
+        Array<double> times;
+        double total = 0;
+
+        while (times.size() < maxIterations && (times.isEmpty() || total < options.minSeconds))
+        {
+            const int64 start = Time::getHighResolutionTicks();
+            operation();
+            const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+
+            times.add (seconds);
+            total += seconds;
+        }
+
+        const MemoryStats::Snapshot after (MemoryStats::getAllocations());
+        times.sort();
+
+        Measurement m;
+        m.operation = name;
+        m.numBytes = numBytes;
+        m.numIterations = times.size();
+        m.medianSeconds = times[times.size() / 2];
+        m.minSeconds = times.getFirst();
+        m.numAllocations = (double) (after.numAllocations - before.numAllocations) / times.size();
+        m.numBytesAllocated = (double) (after.numBytesAllocated - before.numBytesAllocated) / times.size();
+        m.peakResidentBytes = MemoryStats::getPeakResidentBytes();
+        m.serializerStats = SerializerStats::getTotals();
+        return m;
+    }
+
+    static Array<Measurement> runCase (const BenchmarkCase& benchmarkCase, const Options& options)
+    {
+        ScopedPointer<AttributedString> document (DocumentGenerator::createAttributedString (benchmarkCase.parameters));
+
+        MemoryBlock xml, compressedXml, rtf, binary;
+
+        {
+            MemoryOutputStream xmlStream (xml, false), compressedXmlStream (compressedXml, false);
+            MemoryOutputStream rtfStream (rtf, false), binaryStream (binary, false);
+            AttributedStringSerializer::writeAttributedStringToOutputStream (*document, xmlStream);
+            AttributedStringSerializer::writeAttributedStringToOutputStream (*document, compressedXmlStream, true);
+            DocumentGenerator::writeRtf (*document, rtfStream,
+                                         benchmarkCase.parameters.script == DocumentGenerator::Script::cyrillic ? 1251 : 1252);
+            AttributedStringSerializer::writeAttributedStringToBinary (*document, binaryStream);
+        }
+
+        Array<Measurement> results;
+
+        results.add (measure ("xml-save", (int64) xml.getSize(), options, [&]
+        {
+            MemoryOutputStream out;
+            AttributedStringSerializer::writeAttributedStringToOutputStream (*document, out);
+        }));
+
+        results.add (measure ("xml-load", (int64) xml.getSize(), options, [&]
+        {
+            MemoryInputStream in (xml, false);
+            ScopedPointer<AttributedString> loaded (AttributedStringSerializer::createAttributedStringFromInputStream (in));
+        }));
+
+        results.add (measure ("xml-roundtrip", (int64) xml.getSize(), options, [&]
+        {
+            MemoryInputStream in (xml, false);
+            ScopedPointer<AttributedString> loaded (AttributedStringSerializer::createAttributedStringFromInputStream (in));
+
+            MemoryOutputStream out;
+            AttributedStringSerializer::writeAttributedStringToOutputStream (*loaded, out);
+        }));
+
+        // these count the uncompressed bytes, so that they compare with the plain XML
+        results.add (measure ("xml-gz-save", (int64) xml.getSize(), options, [&]
+        {
+            MemoryOutputStream out;
+            AttributedStringSerializer::writeAttributedStringToOutputStream (*document, out, true);
+        }));
+
+        results.add (measure ("xml-gz-load", (int64) xml.getSize(), options, [&]
+        {
+            MemoryInputStream in (compressedXml, false);
+            ScopedPointer<AttributedString> loaded (AttributedStringSerializer::createAttributedStringFromInputStream (in));
+        }));
+
+        results.getReference (results.size() - 2).numStoredBytes = (int64) compressedXml.getSize();
+        results.getReference (results.size() - 1).numStoredBytes = (int64) compressedXml.getSize();
+
+        results.add (measure ("rtf-load", (int64) rtf.getSize(), options, [&]
+        {
+            MemoryInputStream in (rtf, false);
+            ScopedPointer<AttributedString> loaded (AttributedStringSerializer::createAttributedStringFromRTFData (in));
+        }));
+
+        {
+            // what a batch converter does: the string and the parse buffers are kept between loads
+            AttributedString loaded;
+            ParseArena arena;
+
+            results.add (measure ("rtf-load-reuse", (int64) rtf.getSize(), options, [&]
+            {
+                MemoryInputStream in (rtf, false);
+                AttributedStringSerializer::loadAttributedStringFromRTFData (in, loaded, nullptr, nullptr, nullptr, &arena);
+            }));
+        }
+
+        // rtf-load is the same on one thread
+        for (int numThreads = 2; numThreads <= 8; numThreads *= 2)
+        {
+            results.add (measure ("rtf-load-parallel-" + String (numThreads), (int64) rtf.getSize(), options, [&]
+            {
+                ScopedPointer<AttributedString> loaded (AttributedStringSerializer::createAttributedStringFromRTFDataInParallel (rtf.getData(), rtf.getSize(), numThreads));
+            }));
+        }
+
+        // RTF to XML, plain text and HTML: one after the other, then with the writers running alongside the parser
+        results.add (measure ("export-sequential", (int64) rtf.getSize(), options, [&]
+        {
+            MemoryInputStream in (rtf, false);
+            ScopedPointer<AttributedString> loaded (AttributedStringSerializer::createAttributedStringFromRTFData (in));
+
+            MemoryOutputStream xmlOut, textOut, htmlOut;
+            AttributedStringXmlWriter::write (*loaded, xmlOut);
+            AttributedStringTextWriter::writePlainText (*loaded, textOut);
+            AttributedStringTextWriter::writeHtml (*loaded, htmlOut);
+        }));
+
+        results.add (measure ("export-fanout", (int64) rtf.getSize(), options, [&]
+        {
+            MemoryInputStream in (rtf, false);
+            MemoryOutputStream xmlOut, textOut, htmlOut;
+
+            ExportPipeline pipeline;
+            pipeline.addWriter (new AttributedStringXmlWriter::RunWriter (xmlOut));
+            pipeline.addWriter (new AttributedStringTextWriter::PlainTextRunWriter (textOut));
+            pipeline.addWriter (new AttributedStringTextWriter::HtmlRunWriter (htmlOut));
+            pipeline.run (in, true);
+        }));
+
+        results.add (measure ("binary-save", (int64) binary.getSize(), options, [&]
+        {
+            MemoryOutputStream out;
+            AttributedStringSerializer::writeAttributedStringToBinary (*document, out);
+        }));
+
+        results.add (measure ("binary-load", (int64) binary.getSize(), options, [&]
+        {
+            ScopedPointer<AttributedString> loaded (AttributedStringSerializer::createAttributedStringFromBinary (binary.getData(), binary.getSize()));
+        }));
+
+        const int64 textBytes = (int64) document->getText().getNumBytesAsUTF8();
+
+        results.add (measure ("runtable-build", textBytes, options, [&]
+        {
+            AttributedRunTable table (*document);
+        }));
+
+        {
+            const AttributedRunTable table (*document);
+
+            // looks up the font of every character, as a hit test or a cursor moving through the text would
+            results.add (measure ("runtable-lookup", textBytes, options, [&]
+            {
+                const Font* volatile font = nullptr;
+
+                for (int i = 0; i < table.getTextLength(); ++i)
+                    font = table.getFontAt (i);
+
+                ignoreUnused (font);
+            }));
+        }
+
+        return results;
+    }
+
+    //==============================================================================
+    static double getNanosecondsPerByte (const Measurement& m)
+    {
+        return m.numBytes > 0 ? m.medianSeconds * 1.0e9 / (double) m.numBytes : 0.0;
+    }
+
+    static double getMegabytesPerSecond (const Measurement& m)
+    {
+        return m.medianSeconds > 0 ? (double) m.numBytes / (m.medianSeconds * 1024.0 * 1024.0) : 0.0;
+    }
+
+    static void printRow (std::ostream& out, const String& caseName, const String& operation, const String& bytes,
+                          const String& nsPerByte, const String& megabytesPerSecond, const String& allocations, const String& peak)
+    {
+        out << caseName.paddedRight (' ', 18) << operation.paddedRight (' ', 22)
+            << bytes.paddedLeft (' ', 11) << nsPerByte.paddedLeft (' ', 10) << megabytesPerSecond.paddedLeft (' ', 10)
+            << allocations.paddedLeft (' ', 11) << peak.paddedLeft (' ', 9) << std::endl;
+    }
+
+    static void printMeasurement (std::ostream& out, const String& caseName, const Measurement& m)
+    {
+        printRow (out, caseName, m.operation, String (m.numBytes),
+                  String (getNanosecondsPerByte (m), 2), String (getMegabytesPerSecond (m), 1),
+                  String ((int64) m.numAllocations), String (m.peakResidentBytes >> 20));
+    }
+
+    static var toJson (const DocumentGenerator::Parameters& p)
+    {
+        DynamicObject::Ptr o (new DynamicObject());
+        o->setProperty ("textBytes", p.textBytes);
+        o->setProperty ("averageRunLength", p.averageRunLength);
+        o->setProperty ("newlineShare", p.newlineShare);
+        o->setProperty ("numFonts", p.numFonts);
+        o->setProperty ("nonAsciiShare", p.nonAsciiShare);
+        o->setProperty ("script", p.script == DocumentGenerator::Script::cyrillic ? "cyrillic"
+                                    : p.script == DocumentGenerator::Script::cjk ? "cjk" : "mixed");
+        o->setProperty ("seed", p.seed);
+        return var (o.get());
+    }
+
+    static var toJson (const Measurement& m)
+    {
+        DynamicObject::Ptr o (new DynamicObject());
+        o->setProperty ("operation", m.operation);
+        o->setProperty ("bytes", m.numBytes);
+
+        if (m.numStoredBytes > 0)
+        {
+            o->setProperty ("storedBytes", m.numStoredBytes);
+            o->setProperty ("compressionRatio", (double) m.numBytes / (double) m.numStoredBytes);
+        }
+
+        o->setProperty ("iterations", m.numIterations);
+        o->setProperty ("medianSeconds", m.medianSeconds);
+        o->setProperty ("minSeconds", m.minSeconds);
+        o->setProperty ("nsPerByte", getNanosecondsPerByte (m));
+        o->setProperty ("megabytesPerSecond", getMegabytesPerSecond (m));
+        o->setProperty ("allocationsPerIteration", m.numAllocations);
+        o->setProperty ("bytesAllocatedPerIteration", m.numBytesAllocated);
+        o->setProperty ("peakResidentBytes", m.peakResidentBytes);
+        return var (o.get());
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    StringArray args;
+
+    for (int i = 1; i < argc; ++i)
+        args.add (CharPointer_UTF8 (argv[i]));
+
+    Options options;
+
+    SerializerStats::setAllocationCounter ([] { return MemoryStats::getAllocations().numAllocations; });
+
+    if (! parseArguments (args, options))
+    {
+        printUsage();
+        return 2;
+    }
+
+    std::ostream& table = options.jsonToStdout ? std::cerr : std::cout;
+
+    printRow (table, "case", "operation", "bytes", "ns/byte", "MB/s", "allocs", "peak MB");
+
+    var cases = Array<var>();
+
+    for (auto& benchmarkCase : createCases (options))
+    {
+        var measurements = Array<var>();
+
+        for (auto& m : runCase (benchmarkCase, options))
+        {
+            printMeasurement (table, benchmarkCase.name, m);
+
+            if (m.numStoredBytes > 0)
+                table << "    compressed to " << m.numStoredBytes << " bytes, "
+                      << String ((double) m.numBytes / (double) m.numStoredBytes, 1) << ":1" << std::endl;
+
+            if (SerializerStats::isEnabled())
+                table << "    " << m.serializerStats.toString() << std::endl;
+
+            measurements.append (toJson (m));
+        }
+
+        DynamicObject::Ptr o (new DynamicObject());
+        o->setProperty ("name", benchmarkCase.name);
+        o->setProperty ("parameters", toJson (benchmarkCase.parameters));
+        o->setProperty ("results", measurements);
+        cases.append (var (o.get()));
+    }
+
+    if (options.jsonToStdout || options.jsonFile != File())
+    {
+        DynamicObject::Ptr root (new DynamicObject());
+        root->setProperty ("formatVersion", 1);
+        root->setProperty ("time", Time::getCurrentTime().toISO8601 (true));
+        root->setProperty ("os", SystemStats::getOperatingSystemName());
+        root->setProperty ("numCpus", SystemStats::getNumCpus());
+        root->setProperty ("juceVersion", SystemStats::getJUCEVersion());
+        root->setProperty ("cases", cases);
+
+        const String json (JSON::toString (var (root.get())));
+
+        if (options.jsonToStdout)
+            std::cout << json << std::endl;
+        else if (! options.jsonFile.replaceWithText (json))
+            std::cerr << "Couldn't write " << options.jsonFile.getFullPathName() << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "MemoryStats.h"
+
+#include <atomic>
+#include <new>
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+ #include <psapi.h>
+ #pragma comment (lib, "psapi.lib")
+#else
+ #include <sys/resource.h>
+#endif
+
+namespace
+{
+    // these have to work before any constructors have run
+    std::atomic<int64> numAllocations { 0 }, numBytesAllocated { 0 };
+
+    static void countAllocation (size_t numBytes) noexcept
+    {
+        numAllocations.fetch_add (1, std::memory_order_relaxed);
+        numBytesAllocated.fetch_add ((int64) numBytes, std::memory_order_relaxed);
+    }
+}
+
+#if JUCE_LINUX && defined (__GLIBC__)
+extern "C"
+{
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+
+    void* malloc (size_t size)                  { countAllocation (size); return __libc_malloc (size); }
+    void* calloc (size_t num, size_t size)      { countAllocation (num * size); return __libc_calloc (num, size); }
+    void* realloc (void* p, size_t size)        { countAllocation (size); return __libc_realloc (p, size); }
+}
+#else
+void* operator new (size_t size)
+{
+    countAllocation (size);
+
+    if (void* p = std::malloc (size > 0 ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (size_t size)                  { return operator new (size); }
+void operator delete (void* p) noexcept             { std::free (p); }
+void operator delete[] (void* p) noexcept           { std::free (p); }
+void operator delete (void* p, size_t) noexcept     { std::free (p); }
+void operator delete[] (void* p, size_t) noexcept   { std::free (p); }
+#endif
+
+//==============================================================================
+MemoryStats::Snapshot MemoryStats::getAllocations() noexcept
+{
+    Snapshot s;
+    s.numAllocations = numAllocations.load();
+    s.numBytesAllocated = numBytesAllocated.load();
+    return s;
+}
+
+int64 MemoryStats::getPeakResidentBytes()
+{
+   #if JUCE_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (GetProcessMemoryInfo (GetCurrentProcess(), &counters, sizeof (counters)))
+        return (int64) counters.PeakWorkingSetSize;
+
+    return 0;
+   #elif JUCE_LINUX
+    // unlike ru_maxrss, VmHWM can be reset through clear_refs
+    long long kiloBytes = 0;
+
+    if (FILE* f = fopen ("/proc/self/status", "r"))
+    {
+        char line[256];
+
+        while (fgets (line, sizeof (line), f) != nullptr)
+            if (sscanf (line, "VmHWM: %lld kB", &kiloBytes) == 1)
+                break;
+
+        fclose (f);
+    }
+
+    return (int64) kiloBytes * 1024;
+   #else
+    struct rusage usage;
+
+    if (getrusage (RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    #if JUCE_MAC || JUCE_IOS
+     return (int64) usage.ru_maxrss;            // in bytes
+    #else
+     return (int64) usage.ru_maxrss * 1024;     // in kilobytes
+    #endif
+   #endif
+}
+
+void MemoryStats::resetPeakResidentBytes()
+{
+   #if JUCE_LINUX
+    // see proc(5): writing 5 to clear_refs resets the peak RSS
+    if (FILE* f = fopen ("/proc/self/clear_refs", "w"))
+    {
+        fputs ("5", f);
+        fclose (f);
+    }
+   #endif
+}
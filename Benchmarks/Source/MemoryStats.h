@@ -0,0 +1,39 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/**
+    Allocation counters and the process's peak resident set size.
+
+    With glibc every malloc, calloc and realloc is counted (which includes the
+    ones made by operator new and HeapBlock). Everywhere else only operator new
+    can be replaced portably, so allocations made by HeapBlock (e.g. the storage
+    of Arrays and MemoryBlocks) aren't included there.
+*/
+struct MemoryStats
+{
+    struct Snapshot
+    {
+        int64 numAllocations = 0, numBytesAllocated = 0;
+    };
+
+    static Snapshot getAllocations() noexcept;
+
+    /** Returns 0 if the platform can't tell. */
+    static int64 getPeakResidentBytes();
+
+    /** Starts measuring the peak from the current resident size again. This is
+        only possible on Linux; elsewhere the peak covers the process's lifetime.
+    */
+    static void resetPeakResidentBytes();
+};
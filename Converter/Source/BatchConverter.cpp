@@ -0,0 +1,228 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "BatchConverter.h"
+#include "ConversionCache.h"
+#include "../../Source/AttributedStringSerializer.h"
+#include "../../Source/EmbeddedData.h"
+#include "../../Source/ParseArena.h"
+
+namespace
+{
+    class ConversionWorker  : public ThreadPoolJob
+    {
+    public:
+        ConversionWorker (const BatchConverter& c, const Array<BatchConverter::Job>& j,
+                          Array<BatchConverter::Result>& r, Atomic<int>& n, int p)
+            : ThreadPoolJob ("Conversion worker"), converter (c), jobs (j), results (r), nextJob (n),
+              numParseThreads (p)
+        {
+        }
+
+        JobStatus runJob() override
+        {
+            for (;;)
+            {
+                const int index = (++nextJob) - 1;
+
+                if (index >= jobs.size())
+                    return jobHasFinished;
+
+                // every worker writes to different elements, and the array never reallocates
+                results.getReference (index) = converter.convert (jobs.getReference (index), numParseThreads, &arena);
+            }
+        }
+
+    private:
+        const BatchConverter& converter;
+        const Array<BatchConverter::Job>& jobs;
+        Array<BatchConverter::Result>& results;
+        Atomic<int>& nextJob;
+        const int numParseThreads;
+        ParseArena arena;
+
+        JUCE_DECLARE_NON_COPYABLE (ConversionWorker)
+    };
+}
+
+//==============================================================================
+const char* const BatchConverter::version = "3";
+
+BatchConverter::BatchConverter (OutputFormat formatToUse, ConversionCache* cacheToUse)
+    : format (formatToUse), cache (cacheToUse)
+{
+}
+
+void BatchConverter::setLoadLimits (const LoadLimits& newLimits)
+{
+    limits = newLimits;
+    hasLimits = true;
+}
+
+void BatchConverter::setCompressesXml (bool shouldCompress) noexcept
+{
+    compressesXml = shouldCompress;
+}
+
+void BatchConverter::setExtractsEmbeddedData (bool shouldExtract) noexcept
+{
+    extractsEmbeddedData = shouldExtract;
+}
+
+void BatchConverter::setParsesInParallel (bool shouldParseInParallel) noexcept
+{
+    parsesInParallel = shouldParseInParallel;
+}
+
+File BatchConverter::getEmbeddedDataDirectory (const File& output)
+{
+    return output.getSiblingFile (output.getFileNameWithoutExtension() + "-embedded");
+}
+
+Array<BatchConverter::Result> BatchConverter::run (const Array<Job>& jobs, int numThreads)
+{
+    Array<Result> results;
+    results.resize (jobs.size());
+
+    const int numParseThreads = parsesInParallel ? jmax (1, numThreads / jmax (1, jobs.size())) : 1;
+    numThreads = jlimit (1, jmax (1, jobs.size()), numThreads);
+
+    Atomic<int> nextJob;
+    OwnedArray<ConversionWorker> workers;
+    ThreadPool pool (numThreads);
+
+    for (int i = 0; i < numThreads; ++i)
+        pool.addJob (workers.add (new ConversionWorker (*this, jobs, results, nextJob, numParseThreads)), false);
+
+    for (auto* worker : workers)
+        pool.waitForJobToFinish (worker, -1);
+
+    return results;
+}
+
+BatchConverter::Result BatchConverter::convert (const Job& job, int numParseThreads, ParseArena* arena) const
+{
+    Result result;
+    const int64 startTicks = Time::getHighResolutionTicks();
+    uint64 inputHash = 0;
+
+    if (cache != nullptr)
+    {
+        const ConversionCache::Outcome outcome = cache->prepare (job.input, job.output, inputHash);
+
+        if (outcome != ConversionCache::Outcome::needsConverting)
+        {
+            if (outcome == ConversionCache::Outcome::restored)
+            {
+                result.action = Result::Action::restoredFromCache;
+                result.numBytesRead = job.input.getSize();
+                result.numBytesWritten = job.output.getSize();
+            }
+            else
+            {
+                result.action = Result::Action::upToDate;
+            }
+
+            result.seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+            return result;
+        }
+    }
+
+    result.numBytesRead = job.input.getSize();
+
+    // each job needs its own copy, as the limits record which one was hit
+    LoadLimits jobLimits (limits);
+    LoadLimits* const limitsToUse = (hasLimits ? &jobLimits : nullptr);
+
+    AttributedString attributedString;
+    bool loaded;
+    ScopedPointer<EmbeddedDataFileWriter> embeddedData;
+
+    if (extractsEmbeddedData && job.input.hasFileExtension ("rtf"))
+    {
+        embeddedData = new EmbeddedDataFileWriter (getEmbeddedDataDirectory (job.output));
+        embeddedData->deleteOldFiles();
+    }
+
+    if (! job.input.hasFileExtension ("rtf"))
+    {
+        loaded = AttributedStringSerializer::loadAttributedStringFromFile (job.input, attributedString, nullptr, limitsToUse, arena);
+    }
+    else if (numParseThreads > 1 && limitsToUse == nullptr && embeddedData == nullptr)
+    {
+        const ScopedPointer<AttributedString> parsed (AttributedStringSerializer::createAttributedStringFromRTFFileInParallel (job.input, numParseThreads));
+        loaded = (parsed != nullptr);
+
+        if (loaded)
+            attributedString = *parsed;
+    }
+    else
+    {
+        loaded = AttributedStringSerializer::loadAttributedStringFromRTFFile (job.input, attributedString, nullptr, limitsToUse,
+                                                                             embeddedData, arena);
+    }
+
+    if (embeddedData != nullptr)
+        result.numEmbeddedFiles = embeddedData->getFiles().size();
+
+    if (! loaded)
+    {
+        result.error = jobLimits.wasExceeded() ? jobLimits.getErrorMessage() : String ("couldn't be read");
+    }
+    else if (job.output.getParentDirectory().createDirectory().failed())
+    {
+        result.error = "couldn't create " + job.output.getParentDirectory().getFullPathName();
+    }
+    else
+    {
+        TemporaryFile temp (job.output);
+
+        {
+            FileOutputStream out (temp.getFile());
+
+            if (out.failedToOpen())
+            {
+                result.error = "couldn't write " + temp.getFile().getFullPathName();
+            }
+            else
+            {
+                if (format == OutputFormat::binary)
+                    AttributedStringSerializer::writeAttributedStringToBinary (attributedString, out, true);
+                else
+                    AttributedStringSerializer::writeAttributedStringToOutputStream (attributedString, out, compressesXml);
+
+                out.flush();
+
+                if (out.getStatus().failed())
+                    result.error = out.getStatus().getErrorMessage();
+            }
+        }
+
+        if (result.error.isEmpty())
+        {
+            if (temp.overwriteTargetFileWithTemporary())
+            {
+                result.numBytesWritten = job.output.getSize();
+
+                if (cache != nullptr)
+                    cache->store (job.input, job.output, inputHash);
+            }
+            else
+                result.error = "couldn't replace " + job.output.getFullPathName();
+        }
+    }
+
+    result.seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+    return result;
+}
+
+const char* BatchConverter::getFileExtension (OutputFormat f) noexcept
+{
+    return f == OutputFormat::binary ? ".jasb" : ".xml";
+}
@@ -0,0 +1,124 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/LoadLimits.h"
+
+class ConversionCache;
+class ParseArena;
+
+//==============================================================================
+/**
+    Converts a list of files on a pool of threads.
+
+    Each worker thread keeps taking the next unconverted file from the list
+    until there are none left, so a few large documents don't hold up the rest.
+    With setParsesInParallel(), when there are fewer files than threads, the
+    spare threads help to parse the RTF ones. With a ConversionCache, only the
+    files which have changed are converted.
+
+    Binary outputs include a paragraph index, so that any part of them can be
+    loaded on its own.
+    Every output is written to a temporary file next to its destination first and
+    then moved into place, so a destination is either left alone or completely
+    replaced, even if the conversion fails or the process is killed.
+*/
+class BatchConverter
+{
+public:
+    enum class OutputFormat
+    {
+        xml,
+        binary
+    };
+
+    struct Job
+    {
+        File input, output;
+    };
+
+    struct Result
+    {
+        enum class Action
+        {
+            converted,
+            restoredFromCache,
+            upToDate            // nothing was read or written
+        };
+
+        Action action = Action::converted;
+        int64 numBytesRead = 0, numBytesWritten = 0;
+        int numEmbeddedFiles = 0;
+        double seconds = 0;
+        String error;           // empty if the conversion succeeded
+    };
+
+    /** The cache, if any, must outlive the converter. */
+    BatchConverter (OutputFormat format, ConversionCache* cache = nullptr);
+
+    /** Makes the converter load every file within these limits, for files which
+        come from untrusted sources. A file which exceeds them fails with an
+        error saying which limit it hit. RTF files are then always parsed on a
+        single thread. Call this before run().
+    */
+    void setLoadLimits (const LoadLimits& newLimits);
+
+    /** Makes XML outputs gzip-compressed. They keep their extension, as the
+        loaders recognise compressed files by themselves. Call this before run().
+    */
+    void setCompressesXml (bool shouldCompress) noexcept;
+
+    /** Makes the converter write the pictures, objects and themes of RTF files
+        to a directory next to each output: see getEmbeddedDataDirectory(). RTF
+        files are then always parsed on a single thread. A ConversionCache only
+        keeps the outputs, so don't give the converter one which has a
+        directory. Call this before run().
+    */
+    void setExtractsEmbeddedData (bool shouldExtract) noexcept;
+
+    /** Lets the threads which aren't needed for a file of their own help to parse
+        the RTF files: see RtfParser::parseInParallel(). It's off by default, as
+        how well that scales depends on the documents and the machine, so measure
+        it on yours with the benchmarks first. Call this before run().
+    */
+    void setParsesInParallel (bool shouldParseInParallel) noexcept;
+
+    /** Where the embedded data of an output goes, e.g. "doc-embedded" for "doc.xml". */
+    static File getEmbeddedDataDirectory (const File& output);
+
+    /** Goes into the cache's hashes, so that a new version converts everything
+        again. Bump it whenever a change to the loaders or writers changes
+        their output.
+    */
+    static const char* const version;
+
+    /** Runs the jobs and returns a result for each of them, in the same order. */
+    Array<Result> run (const Array<Job>& jobs, int numThreads);
+
+    /** Converts a single file on the calling thread, using up to the given number
+        of threads to parse it if it's RTF. A thread which converts one file after
+        another can pass the same ParseArena each time.
+    */
+    Result convert (const Job& job, int numParseThreads = 1, ParseArena* arena = nullptr) const;
+
+    static const char* getFileExtension (OutputFormat format) noexcept;
+
+private:
+    const OutputFormat format;
+    ConversionCache* const cache;
+    LoadLimits limits;
+    bool hasLimits = false;
+    bool compressesXml = false;
+    bool extractsEmbeddedData = false;
+    bool parsesInParallel = false;
+
+    JUCE_DECLARE_NON_COPYABLE (BatchConverter)
+};
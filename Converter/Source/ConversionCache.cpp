@@ -0,0 +1,258 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "ConversionCache.h"
+
+namespace
+{
+    const char* const recordFileName = "record.txt";
+    const char* const recordHeader = "RtfConverter cache, version ";
+}
+
+//==============================================================================
+ConversionCache::ConversionCache (const File& d, const String& converterVersion)
+    : directory (d), version (converterVersion),
+      versionSeed (hash (converterVersion.toRawUTF8(), converterVersion.getNumBytesAsUTF8(), 0))
+{
+    load();
+}
+
+ConversionCache::~ConversionCache()
+{
+    save();
+}
+
+//==============================================================================
+ConversionCache::Outcome ConversionCache::prepare (const File& input, const File& output, uint64& inputHash)
+{
+    inputHash = 0;
+
+    Entry entry;
+    bool hasEntry;
+
+    {
+        const ScopedLock sl (lock);
+
+        hasEntry = entries.contains (output.getFullPathName());
+
+        if (hasEntry)
+            entry = entries[output.getFullPathName()];
+    }
+
+    // an output which has been changed or removed since it was recorded needs replacing
+    const bool outputIsAsRecorded = hasEntry
+                                     && entry.input == input.getFullPathName()
+                                     && output.existsAsFile()
+                                     && entry.outputSize == output.getSize()
+                                     && entry.outputTime == output.getLastModificationTime().toMilliseconds();
+
+    if (outputIsAsRecorded
+         && entry.inputSize == input.getSize()
+         && entry.inputTime == input.getLastModificationTime().toMilliseconds())
+        return Outcome::upToDate;
+
+    if (! hashFile (input, inputHash))
+        return Outcome::needsConverting;
+
+    if (outputIsAsRecorded && entry.hash == inputHash)
+    {
+        // only the time has changed: record the new one so that it isn't hashed again
+        record (input, output, inputHash);
+        return Outcome::upToDate;
+    }
+
+    const File keptOutput (getKeptOutput (inputHash, output));
+
+    if (keptOutput.existsAsFile() && output.getParentDirectory().createDirectory().wasOk())
+    {
+        TemporaryFile temp (output);
+
+        if (keptOutput.copyFileTo (temp.getFile()) && temp.overwriteTargetFileWithTemporary())
+        {
+            record (input, output, inputHash);
+            return Outcome::restored;
+        }
+    }
+
+    return Outcome::needsConverting;
+}
+
+void ConversionCache::store (const File& input, const File& output, uint64 inputHash)
+{
+    if (inputHash == 0)
+        return;
+
+    const File keptOutput (getKeptOutput (inputHash, output));
+
+    if (keptOutput != File() && ! keptOutput.existsAsFile()
+         && keptOutput.getParentDirectory().createDirectory().wasOk())
+    {
+        TemporaryFile temp (keptOutput);
+
+        if (output.copyFileTo (temp.getFile()))
+            temp.overwriteTargetFileWithTemporary();
+    }
+
+    record (input, output, inputHash);
+}
+
+//==============================================================================
+bool ConversionCache::save()
+{
+    if (directory == File())
+        return true;
+
+    const ScopedLock sl (lock);
+
+    if (! hasChanged)
+        return true;
+
+    if (directory.createDirectory().failed())
+        return false;
+
+    TemporaryFile temp (directory.getChildFile (recordFileName));
+
+    {
+        FileOutputStream out (temp.getFile());
+
+        if (out.failedToOpen())
+            return false;
+
+        out << recordHeader << version << "\n";
+
+        for (HashMap<String, Entry>::Iterator i (entries); i.next();)
+        {
+            const Entry e (i.getValue());
+
+            out << i.getKey() << "\t" << e.input
+                << "\t" << String (e.inputSize) << "\t" << String (e.inputTime)
+                << "\t" << String::toHexString ((int64) e.hash)
+                << "\t" << String (e.outputSize) << "\t" << String (e.outputTime) << "\n";
+        }
+
+        out.flush();
+
+        if (out.getStatus().failed())
+            return false;
+    }
+
+    if (! temp.overwriteTargetFileWithTemporary())
+        return false;
+
+    hasChanged = false;
+    return true;
+}
+
+void ConversionCache::load()
+{
+    if (directory == File())
+        return;
+
+    const StringArray lines (StringArray::fromLines (directory.getChildFile (recordFileName).loadFileAsString()));
+
+    // another version of the converter might have produced different outputs
+    if (lines[0] != recordHeader + version)
+        return;
+
+    for (int i = 1; i < lines.size(); ++i)
+    {
+        StringArray fields;
+        fields.addTokens (lines[i], "\t", "");
+
+        if (fields.size() != 7)
+            continue;
+
+        Entry e;
+        e.input      = fields[1];
+        e.inputSize  = fields[2].getLargeIntValue();
+        e.inputTime  = fields[3].getLargeIntValue();
+        e.hash       = (uint64) fields[4].getHexValue64();
+        e.outputSize = fields[5].getLargeIntValue();
+        e.outputTime = fields[6].getLargeIntValue();
+
+        entries.set (fields[0], e);
+    }
+}
+
+//==============================================================================
+void ConversionCache::record (const File& input, const File& output, uint64 inputHash)
+{
+    Entry e;
+    e.input      = input.getFullPathName();
+    e.inputSize  = input.getSize();
+    e.inputTime  = input.getLastModificationTime().toMilliseconds();
+    e.hash       = inputHash;
+    e.outputSize = output.getSize();
+    e.outputTime = output.getLastModificationTime().toMilliseconds();
+
+    const ScopedLock sl (lock);
+    entries.set (output.getFullPathName(), e);
+    hasChanged = true;
+}
+
+bool ConversionCache::hashFile (const File& file, uint64& result) const
+{
+    if (! file.existsAsFile())
+        return false;
+
+    if (file.getSize() == 0)
+    {
+        result = hash (nullptr, 0, versionSeed);
+        return true;
+    }
+
+    MemoryMappedFile mappedFile (file, MemoryMappedFile::readOnly);
+
+    if (mappedFile.getData() == nullptr)
+        return false;
+
+    result = hash (mappedFile.getData(), mappedFile.getSize(), versionSeed);
+    return true;
+}
+
+File ConversionCache::getKeptOutput (uint64 inputHash, const File& output) const
+{
+    if (directory == File())
+        return {};
+
+    // the extension keeps the outputs of different formats apart
+    return directory.getChildFile ("outputs")
+                    .getChildFile (String::toHexString ((int64) inputHash).paddedLeft ('0', 16) + output.getFileExtension());
+}
+
+//==============================================================================
+uint64 ConversionCache::hash (const void* data, size_t numBytes, uint64 seed) noexcept
+{
+    // the rounds and the final mix of xxHash64, on a single lane
+    const uint64 prime1 = 0x9e3779b185ebca87ULL, prime2 = 0xc2b2ae3d27d4eb4fULL,
+                 prime3 = 0x165667b19e3779f9ULL, prime5 = 0x27d4eb2f165667c5ULL;
+
+    auto rotateLeft = [] (uint64 x, int bits) noexcept { return (x << bits) | (x >> (64 - bits)); };
+
+    const uint8* p = static_cast<const uint8*> (data);
+    uint64 h = seed + prime5 + (uint64) numBytes;
+
+    for (; numBytes >= 8; numBytes -= 8, p += 8)
+    {
+        const uint64 k = rotateLeft ((uint64) ByteOrder::littleEndianInt64 (p) * prime2, 31) * prime1;
+        h = rotateLeft (h ^ k, 27) * prime1 + prime3;
+    }
+
+    for (; numBytes > 0; --numBytes, ++p)
+        h = rotateLeft (h ^ (*p * prime5), 11) * prime1;
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+
+    // 0 means "not hashed" to store()
+    return h != 0 ? h : 1;
+}
@@ -0,0 +1,88 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/**
+    Remembers what has been converted, so that a build only converts the inputs
+    which have changed since the last one.
+
+    Each output is recorded with the size and modification time of its input and
+    a hash of the input's bytes and the converter version. An output whose input
+    still has the same size and time is up to date without reading anything.
+    Otherwise the input is hashed: if only its time changed,
+    the output is still up to date. If the cache has kept an output in the same
+    format for the same hash before, that one is copied into place instead of
+    converting again.
+
+    The record and the kept outputs live in a directory, which can be shared
+    between builds. A cache without a directory only lasts as long as the
+    object, which is enough for watching a directory.
+
+    All the methods may be called from several threads at once.
+*/
+class ConversionCache
+{
+public:
+    /** Uses the given directory, or none if it's File(). */
+    ConversionCache (const File& directory, const String& converterVersion);
+    ~ConversionCache();
+
+    enum class Outcome
+    {
+        upToDate,           // the output can be left as it is
+        restored,           // the output has been copied from the cache
+        needsConverting
+    };
+
+    /** Checks whether the output needs converting, restoring it from the cache
+        if it can. When it needs converting, the hash to pass to store() is
+        returned, which is 0 if the input couldn't be read.
+    */
+    Outcome prepare (const File& input, const File& output, uint64& inputHash);
+
+    /** Records an output which has just been converted, and keeps a copy of it. */
+    void store (const File& input, const File& output, uint64 inputHash);
+
+    /** Writes the record to the cache directory, if there is one and anything has
+        changed. The destructor calls this too.
+    */
+    bool save();
+
+    /** A quick, non-cryptographic 64-bit hash. */
+    static uint64 hash (const void* data, size_t numBytes, uint64 seed) noexcept;
+
+private:
+    //==============================================================================
+    struct Entry
+    {
+        String input;
+        int64 inputSize = 0, inputTime = 0;
+        uint64 hash = 0;
+        int64 outputSize = 0, outputTime = 0;
+    };
+
+    bool hashFile (const File& file, uint64& result) const;
+    File getKeptOutput (uint64 inputHash, const File& output) const;
+    void record (const File& input, const File& output, uint64 inputHash);
+    void load();
+
+    const File directory;
+    const String version;
+    const uint64 versionSeed;
+
+    CriticalSection lock;
+    HashMap<String, Entry> entries;     // by output path
+    bool hasChanged = false;
+
+    JUCE_DECLARE_NON_COPYABLE (ConversionCache)
+};
@@ -0,0 +1,243 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "ConversionClient.h"
+
+#include <iostream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace
+{
+    // Sends its share of the requests over its own connection, keeping a few in
+    // flight so that the server has something to batch.
+    class HarnessConnection  : public ThreadPoolJob
+    {
+    public:
+        HarnessConnection (const File& s, const OwnedArray<MemoryBlock>& d, ConversionServer::Kind k,
+                           int first, int step, int total, Array<int64>& t, LatencyRecorder& l)
+            : ThreadPoolJob ("Conversion client"), socketFile (s), documents (d), kind (k),
+              firstRequest (first), requestStep (step), numRequests (total), sentTicks (t), latencies (l)
+        {
+        }
+
+        JobStatus runJob() override
+        {
+            ConversionClient client;
+            const Result connected (client.connect (socketFile));
+
+            if (connected.failed())
+            {
+                error = connected.getErrorMessage();
+                return jobHasFinished;
+            }
+
+            int numInFlight = 0;
+            int nextRequest = firstRequest;
+            MemoryBlock payload;
+
+            while (nextRequest < numRequests || numInFlight > 0)
+            {
+                if (nextRequest < numRequests && numInFlight < maxInFlight)
+                {
+                    const MemoryBlock& document = *documents.getUnchecked (nextRequest % documents.size());
+
+                    // the ids are the request numbers, and each connection only touches its own
+                    sentTicks.getReference (nextRequest) = Time::getHighResolutionTicks();
+
+                    if (! client.send ((uint32) nextRequest, kind, document.getData(), document.getSize()))
+                        break;
+
+                    nextRequest += requestStep;
+                    ++numInFlight;
+                    continue;
+                }
+
+                uint32 id;
+                ConversionServer::Status status;
+
+                if (! client.receive (id, status, payload) || ! isPositiveAndBelow ((int) id, numRequests))
+                    break;
+
+                latencies.add (Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - sentTicks[(int) id]));
+                --numInFlight;
+                ++numReceived;
+
+                if (status != ConversionServer::Status::ok)
+                {
+                    ++numFailed;
+
+                    if (error.isEmpty())
+                        error = "request " + String (id) + ": " + payload.toString();
+                }
+            }
+
+            if (nextRequest < numRequests || numInFlight > 0)
+                error = "the server closed the connection";
+
+            return jobHasFinished;
+        }
+
+        int numReceived = 0, numFailed = 0;
+        String error;
+
+    private:
+        enum { maxInFlight = 8 };
+
+        const File socketFile;
+        const OwnedArray<MemoryBlock>& documents;
+        const ConversionServer::Kind kind;
+        const int firstRequest, requestStep, numRequests;
+        Array<int64>& sentTicks;
+        LatencyRecorder& latencies;
+
+        JUCE_DECLARE_NON_COPYABLE (HarnessConnection)
+    };
+}
+
+//==============================================================================
+ConversionClient::~ConversionClient()
+{
+    if (socket >= 0)
+        ::close (socket);
+}
+
+Result ConversionClient::connect (const File& socketFile)
+{
+    const String path (socketFile.getFullPathName());
+
+    sockaddr_un address;
+    zerostruct (address);
+    address.sun_family = AF_UNIX;
+
+    if ((size_t) path.getNumBytesAsUTF8() >= sizeof (address.sun_path))
+        return Result::fail ("the socket path is too long: " + path);
+
+    path.copyToUTF8 (address.sun_path, sizeof (address.sun_path));
+
+    socket = ::socket (AF_UNIX, SOCK_STREAM, 0);
+
+    if (socket < 0 || ::connect (socket, reinterpret_cast<sockaddr*> (&address), sizeof (address)) != 0)
+        return Result::fail ("couldn't connect to " + path);
+
+    return Result::ok();
+}
+
+bool ConversionClient::send (uint32 id, ConversionServer::Kind kind, const void* document, size_t numBytes)
+{
+    uint8 header[ConversionServer::headerSize];
+    ConversionServer::writeHeader (header, (uint32) numBytes, id, (uint8) kind);
+
+    return ConversionServer::writeFully (socket, header, sizeof (header))
+            && ConversionServer::writeFully (socket, document, numBytes);
+}
+
+bool ConversionClient::receive (uint32& id, ConversionServer::Status& status, MemoryBlock& payload)
+{
+    uint8 header[ConversionServer::headerSize];
+
+    if (! ConversionServer::readFully (socket, header, sizeof (header)))
+        return false;
+
+    const uint32 length = ByteOrder::littleEndianInt (header);
+
+    if (length < ConversionServer::headerSize - 4)
+        return false;
+
+    id = ByteOrder::littleEndianInt (header + 4);
+    status = (ConversionServer::Status) header[8];
+
+    payload.setSize (length - (ConversionServer::headerSize - 4));
+    return ConversionServer::readFully (socket, payload.getData(), payload.getSize());
+}
+
+bool ConversionClient::convert (ConversionServer::Kind kind, const MemoryBlock& document,
+                                ConversionServer::Status& status, MemoryBlock& result)
+{
+    const uint32 id = nextId++;
+    uint32 responseId;
+
+    return send (id, kind, document.getData(), document.getSize())
+            && receive (responseId, status, result)
+            && responseId == id;
+}
+
+//==============================================================================
+int ConversionClient::runHarness (const File& socketFile, const Array<File>& inputs, ConversionServer::Kind kind,
+                                  int numConnections, int numRepeats)
+{
+    OwnedArray<MemoryBlock> documents;
+    int64 totalBytes = 0;
+
+    for (auto& input : inputs)
+    {
+        MemoryBlock* document = documents.add (new MemoryBlock());
+
+        if (! input.loadFileAsData (*document))
+        {
+            std::cerr << "Couldn't read " << input.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    if (documents.isEmpty())
+        return 1;
+
+    const int numRequests = documents.size() * jmax (1, numRepeats);
+    numConnections = jlimit (1, numRequests, numConnections);
+
+    for (int i = 0; i < numRequests; ++i)
+        totalBytes += (int64) documents.getUnchecked (i % documents.size())->getSize();
+
+    Array<int64> sentTicks;
+    sentTicks.insertMultiple (0, 0, numRequests);
+
+    LatencyRecorder latencies;
+    OwnedArray<HarnessConnection> connections;
+    ThreadPool pool (numConnections);
+
+    const int64 startTicks = Time::getHighResolutionTicks();
+
+    for (int i = 0; i < numConnections; ++i)
+        pool.addJob (connections.add (new HarnessConnection (socketFile, documents, kind, i, numConnections, numRequests,
+                                                             sentTicks, latencies)), false);
+
+    for (auto* connection : connections)
+        pool.waitForJobToFinish (connection, -1);
+
+    const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+    int numReceived = 0, numFailed = 0;
+
+    for (auto* connection : connections)
+    {
+        numReceived += connection->numReceived;
+        numFailed += connection->numFailed;
+
+        if (connection->error.isNotEmpty())
+            std::cerr << connection->error << std::endl;
+    }
+
+    std::cout << "Sent " << numRequests << " requests (" << File::descriptionOfSizeInBytes (totalBytes) << ") over "
+              << numConnections << " connections in " << String (seconds, 3) << " s: "
+              << String (seconds > 0 ? numReceived / seconds : 0.0, 1) << " requests/s, "
+              << String (seconds > 0 ? totalBytes / (seconds * 1024.0 * 1024.0) : 0.0, 2) << " MB/s" << std::endl
+              << numReceived << " answered, " << numFailed << " failed" << std::endl
+              << "Round trip: " << latencies.getSummary().toString() << std::endl;
+
+    ConversionClient client;
+    ConversionServer::Status status;
+    MemoryBlock statistics;
+
+    if (client.connect (socketFile).wasOk()
+         && client.convert (ConversionServer::Kind::statistics, MemoryBlock(), status, statistics))
+        std::cout << "Server: " << statistics.toString() << std::endl;
+
+    return (numReceived == numRequests && numFailed == 0) ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ConversionServer.h"
+
+//==============================================================================
+/**
+    Talks to a ConversionServer which is listening on a Unix domain socket.
+
+    A client can send several requests before reading their responses, but it
+    mustn't be used by more than one thread at a time.
+*/
+class ConversionClient
+{
+public:
+    ConversionClient() {}
+    ~ConversionClient();
+
+    Result connect (const File& socketFile);
+
+    /** Sends a request without waiting for its response. */
+    bool send (uint32 id, ConversionServer::Kind kind, const void* document, size_t numBytes);
+
+    /** Waits for the next response, which may be to any of the requests sent so far. */
+    bool receive (uint32& id, ConversionServer::Status& status, MemoryBlock& payload);
+
+    /** Sends and waits for the response. */
+    bool convert (ConversionServer::Kind kind, const MemoryBlock& document,
+                  ConversionServer::Status& status, MemoryBlock& result);
+
+    //==============================================================================
+    /** Sends each of the files to the server the given number of times, over several
+        connections at once with a few requests in flight on each, and prints the
+        round-trip latencies along with the server's own statistics. Returns the
+        process exit code.
+    */
+    static int runHarness (const File& socketFile, const Array<File>& inputs, ConversionServer::Kind kind,
+                           int numConnections, int numRepeats);
+
+private:
+    int socket = -1;
+    uint32 nextId = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (ConversionClient)
+};
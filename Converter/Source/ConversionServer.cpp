@@ -0,0 +1,635 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "ConversionServer.h"
+#include "../../Source/AttributedStringSerializer.h"
+#include "../../Source/ParseArena.h"
+
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+//==============================================================================
+void LatencyRecorder::add (double seconds)
+{
+    const ScopedLock sl (lock);
+
+    if (samples.size() < maxNumKept)
+        samples.add (seconds);
+    else
+        samples.set ((int) (numSamples % maxNumKept), seconds);
+
+    ++numSamples;
+}
+
+void LatencyRecorder::reset()
+{
+    const ScopedLock sl (lock);
+    samples.clearQuick();
+    numSamples = 0;
+}
+
+LatencyRecorder::Summary LatencyRecorder::getSummary() const
+{
+    Array<double> sorted;
+    Summary summary;
+
+    {
+        const ScopedLock sl (lock);
+        sorted = samples;
+        summary.numSamples = numSamples;
+    }
+
+    if (sorted.isEmpty())
+        return summary;
+
+    std::sort (sorted.begin(), sorted.end());
+
+    // the nearest rank: the smallest sample which is at least as large as the given share of them
+    auto percentile = [&sorted] (double share)
+    {
+        return sorted.getUnchecked (jlimit (0, sorted.size() - 1, (int) std::ceil (share * sorted.size()) - 1));
+    };
+
+    summary.median = percentile (0.5);
+    summary.p90    = percentile (0.9);
+    summary.p99    = percentile (0.99);
+    summary.max    = sorted.getLast();
+    return summary;
+}
+
+String LatencyRecorder::Summary::toString() const
+{
+    auto ms = [] (double seconds) { return String (seconds * 1000.0, 2) + " ms"; };
+
+    return String (numSamples) + " requests, median " + ms (median) + ", 90% " + ms (p90)
+             + ", 99% " + ms (p99) + ", max " + ms (max);
+}
+
+//==============================================================================
+String ConversionServer::Statistics::toString() const
+{
+    return String (numRequests) + " requests (" + String (numFailed) + " failed) in " + String (numBatches) + " batches, "
+             + File::descriptionOfSizeInBytes (numBytesRead) + " in, " + File::descriptionOfSizeInBytes (numBytesWritten)
+             + " out; latency: " + latency.toString();
+}
+
+//==============================================================================
+// The descriptors of a client, which stay open until the last of its requests
+// has been answered, even if the client stops sending before then.
+class ConversionServer::Connection  : public ReferenceCountedObject
+{
+public:
+    typedef ReferenceCountedObjectPtr<Connection> Ptr;
+
+    Connection (int in, int out, bool ownsDescriptors)
+        : input (in), output (out), closesDescriptors (ownsDescriptors)
+    {
+    }
+
+    ~Connection()
+    {
+        if (closesDescriptors)
+        {
+            ::close (input);
+
+            if (output != input)
+                ::close (output);
+        }
+    }
+
+    /** Writes one or more whole responses, so that the ones written by different
+        workers don't get interleaved.
+    */
+    bool write (const void* data, size_t numBytes)
+    {
+        const ScopedLock sl (writeLock);
+
+        // once the client has gone there's no point trying again
+        if (! hasFailed)
+            hasFailed = ! writeFully (output, data, numBytes);
+
+        return ! hasFailed;
+    }
+
+    /** Unblocks a reader which is waiting for the client. */
+    void stopReading()
+    {
+        ::shutdown (input, SHUT_RD);
+    }
+
+    void requestAdded() noexcept        { ++numPending; }
+
+    void requestAnswered()
+    {
+        if (--numPending == 0)
+            allAnswered.signal();
+    }
+
+    void waitUntilAllAnswered()
+    {
+        while (numPending.get() > 0)
+            allAnswered.wait (100);
+    }
+
+    const int input, output;
+
+private:
+    const bool closesDescriptors;
+
+    CriticalSection writeLock;
+    bool hasFailed = false;
+
+    Atomic<int> numPending;
+    WaitableEvent allAnswered;
+
+    JUCE_DECLARE_NON_COPYABLE (Connection)
+};
+
+//==============================================================================
+struct ConversionServer::Request
+{
+    Connection::Ptr connection;
+    uint32 id = 0;
+    Kind kind = Kind::xml;
+    MemoryBlock document;
+    String error;               // if set, the request is answered with this rather than converted
+    int64 receivedTicks = 0;
+};
+
+//==============================================================================
+class ConversionServer::ConnectionReader  : public Thread
+{
+public:
+    ConnectionReader (ConversionServer& s, Connection* c)
+        : Thread ("Conversion connection"), server (s), connection (c)
+    {
+    }
+
+    ~ConnectionReader()
+    {
+        {
+            const ScopedLock sl (lock);
+
+            if (connection != nullptr)
+                connection->stopReading();
+        }
+
+        stopThread (10000);
+    }
+
+    void run() override
+    {
+        server.readRequests (*connection);
+
+        // the connection closes once the last of its responses has been written
+        const ScopedLock sl (lock);
+        connection = nullptr;
+    }
+
+private:
+    ConversionServer& server;
+    CriticalSection lock;
+    Connection::Ptr connection;
+
+    JUCE_DECLARE_NON_COPYABLE (ConnectionReader)
+};
+
+//==============================================================================
+class ConversionServer::Worker  : public ThreadPoolJob
+{
+public:
+    Worker (ConversionServer& s)  : ThreadPoolJob ("Conversion server worker"), server (s)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        OwnedArray<Request> batch;
+
+        while (server.takeBatch (batch))
+        {
+            server.processBatch (batch, arena);
+            batch.clear();
+        }
+
+        return jobHasFinished;
+    }
+
+private:
+    ConversionServer& server;
+
+    ParseArena arena;   // reused for every request this worker converts
+
+    JUCE_DECLARE_NON_COPYABLE (Worker)
+};
+
+//==============================================================================
+ConversionServer::ConversionServer (int numThreads)
+    : pool (jmax (1, numThreads))
+{
+    // a client which goes away mid-response must only fail that write
+    ::signal (SIGPIPE, SIG_IGN);
+
+    // the first document would otherwise pay for setting up the fonts
+    static const char warmUpDocument[] = "{\\rtf1\\ansi{\\fonttbl{\\f0 Helvetica;}}\\f0 x}";
+    MemoryInputStream warmUp (warmUpDocument, sizeof (warmUpDocument) - 1, false);
+    delete AttributedStringSerializer::createAttributedStringFromRTFData (warmUp);
+
+    for (int i = 0; i < jmax (1, numThreads); ++i)
+        pool.addJob (workers.add (new Worker (*this)), false);
+}
+
+ConversionServer::~ConversionServer()
+{
+    readers.clear();
+
+    {
+        const ScopedLock sl (queueLock);
+        isShuttingDown = true;
+    }
+
+    for (auto* worker : workers)
+        pool.waitForJobToFinish (worker, -1);
+}
+
+void ConversionServer::setLoadLimits (const LoadLimits& newLimits)
+{
+    limits = newLimits;
+    hasLimits = true;
+}
+
+ConversionServer::Statistics ConversionServer::getStatistics() const
+{
+    Statistics s;
+    s.numRequests     = numRequests.get();
+    s.numFailed       = numFailed.get();
+    s.numBatches      = numBatches.get();
+    s.numBytesRead    = numBytesRead.get();
+    s.numBytesWritten = numBytesWritten.get();
+    s.latency         = latencies.getSummary();
+    return s;
+}
+
+//==============================================================================
+void ConversionServer::serveStandardStreams()
+{
+    const Connection::Ptr connection (new Connection (STDIN_FILENO, STDOUT_FILENO, false));
+
+    readRequests (*connection);
+    connection->waitUntilAllAnswered();
+}
+
+Result ConversionServer::serveUnixSocket (const File& socketFile)
+{
+    const String path (socketFile.getFullPathName());
+
+    sockaddr_un address;
+    zerostruct (address);
+    address.sun_family = AF_UNIX;
+
+    if ((size_t) path.getNumBytesAsUTF8() >= sizeof (address.sun_path))
+        return Result::fail ("the socket path is too long: " + path);
+
+    path.copyToUTF8 (address.sun_path, sizeof (address.sun_path));
+
+    // a socket left behind by a server which was killed would stop bind() from
+    // working, but anything else at that path is left alone
+    struct stat info;
+
+    if (::lstat (address.sun_path, &info) == 0 && S_ISSOCK (info.st_mode))
+        ::unlink (address.sun_path);
+
+    const int listener = ::socket (AF_UNIX, SOCK_STREAM, 0);
+
+    if (listener < 0)
+        return Result::fail ("couldn't create a socket");
+
+    if (::bind (listener, reinterpret_cast<sockaddr*> (&address), sizeof (address)) != 0
+         || ::listen (listener, 64) != 0)
+    {
+        ::close (listener);
+        return Result::fail ("couldn't listen on " + path);
+    }
+
+    for (;;)
+    {
+        const int client = ::accept (listener, nullptr, nullptr);
+
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            break;
+        }
+
+        removeFinishedReaders();
+        readers.add (new ConnectionReader (*this, new Connection (client, client, true)))->startThread();
+    }
+
+    ::close (listener);
+    return Result::fail ("couldn't accept connections on " + path);
+}
+
+void ConversionServer::removeFinishedReaders()
+{
+    for (int i = readers.size(); --i >= 0;)
+        if (! readers.getUnchecked (i)->isThreadRunning())
+            readers.remove (i);
+}
+
+//==============================================================================
+void ConversionServer::readRequests (Connection& connection)
+{
+    for (;;)
+    {
+        uint8 header[headerSize];
+
+        if (! readFully (connection.input, header, sizeof (header)))
+            return;
+
+        const uint32 length = ByteOrder::littleEndianInt (header);
+
+        // without a valid length there's no telling where the next request starts
+        if (length < headerSize - 4)
+            return;
+
+        ScopedPointer<Request> request (new Request());
+        request->connection = &connection;
+        request->id = ByteOrder::littleEndianInt (header + 4);
+        request->kind = (Kind) header[8];
+
+        const size_t documentSize = length - (headerSize - 4);
+        bool canContinue = true;
+
+        if (documentSize > (size_t) maxDocumentBytes)
+        {
+            request->error = "the document is larger than " + File::descriptionOfSizeInBytes (maxDocumentBytes);
+            canContinue = false;
+        }
+        else
+        {
+            request->document.setSize (documentSize);
+
+            if (! readFully (connection.input, request->document.getData(), documentSize))
+                return;
+
+            numBytesRead += (int64) (headerSize + documentSize);
+        }
+
+        request->receivedTicks = Time::getHighResolutionTicks();
+        addRequest (request.release());
+
+        if (! canContinue)
+            return;
+    }
+}
+
+void ConversionServer::addRequest (Request* request)
+{
+    ScopedPointer<Request> deleter (request);
+    request->connection->requestAdded();
+
+    for (;;)
+    {
+        {
+            const ScopedLock sl (queueLock);
+
+            // a reader which gets too far ahead of the workers waits for them to catch up
+            if (numQueuedBytes < maxQueuedBytes || queue.isEmpty())
+            {
+                numQueuedBytes += (int64) request->document.getSize();
+                queue.add (deleter.release());
+                break;
+            }
+        }
+
+        requestTaken.wait (100);
+    }
+
+    requestAdded.signal();
+}
+
+bool ConversionServer::takeBatch (OwnedArray<Request>& batch)
+{
+    for (;;)
+    {
+        {
+            const ScopedLock sl (queueLock);
+
+            if (isShuttingDown)
+                return false;
+
+            if (! queue.isEmpty())
+            {
+                batch.add (queue.removeAndReturn (0));
+
+                if (batch.getFirst()->document.getSize() < (size_t) smallRequestBytes)
+                {
+                    // take a fair share of the small requests which are waiting, leaving
+                    // the large ones for other workers to start on straight away
+                    const int maxToTake = jmin ((int) maxBatchSize, 1 + queue.size() / workers.size());
+
+                    for (int i = 0; i < queue.size() && batch.size() < maxToTake;)
+                    {
+                        if (queue.getUnchecked (i)->document.getSize() < (size_t) smallRequestBytes)
+                            batch.add (queue.removeAndReturn (i));
+                        else
+                            ++i;
+                    }
+                }
+
+                for (auto* request : batch)
+                    numQueuedBytes -= (int64) request->document.getSize();
+
+                // the signal which woke this worker may have been for several requests
+                if (! queue.isEmpty())
+                    requestAdded.signal();
+
+                break;
+            }
+        }
+
+        requestAdded.wait (100);
+    }
+
+    requestTaken.signal();
+    return true;
+}
+
+//==============================================================================
+void ConversionServer::processBatch (OwnedArray<Request>& batch, ParseArena& arena)
+{
+    OwnedArray<MemoryOutputStream> responses;
+
+    for (auto* request : batch)
+        convert (*request, *responses.add (new MemoryOutputStream()), arena);
+
+    ++numBatches;
+
+    // the responses to each client go out in a single write
+    for (int i = 0; i < batch.size(); ++i)
+    {
+        const Connection::Ptr connection (batch.getUnchecked (i)->connection);
+
+        if (connection == nullptr)
+            continue;
+
+        MemoryOutputStream combined;
+        const MemoryOutputStream* toWrite = responses.getUnchecked (i);
+
+        for (int j = i + 1; j < batch.size(); ++j)
+        {
+            if (batch.getUnchecked (j)->connection == connection)
+            {
+                if (toWrite != &combined)
+                {
+                    combined << *toWrite;
+                    toWrite = &combined;
+                }
+
+                combined << *responses.getUnchecked (j);
+            }
+        }
+
+        connection->write (toWrite->getData(), toWrite->getDataSize());
+        numBytesWritten += (int64) toWrite->getDataSize();
+
+        const int64 now = Time::getHighResolutionTicks();
+
+        for (int j = i; j < batch.size(); ++j)
+        {
+            Request& request = *batch.getUnchecked (j);
+
+            if (request.connection == connection)
+            {
+                latencies.add (Time::highResolutionTicksToSeconds (now - request.receivedTicks));
+                request.connection = nullptr;
+                connection->requestAnswered();
+            }
+        }
+    }
+}
+
+void ConversionServer::convert (const Request& request, MemoryOutputStream& response, ParseArena& arena)
+{
+    // the header is filled in once the size of what follows it is known
+    uint8 header[headerSize] = {};
+    response.write (header, sizeof (header));
+
+    String error (request.error);
+
+    if (error.isEmpty())
+    {
+        if (request.kind == Kind::statistics)
+        {
+            response << getStatistics().toString();
+        }
+        else if (request.kind != Kind::xml && request.kind != Kind::compressedXml && request.kind != Kind::binary)
+        {
+            error = "unknown request kind " + String ((int) request.kind);
+        }
+        else
+        {
+            // each request needs its own copy, as the limits record which one was hit
+            LoadLimits requestLimits (limits);
+            LoadLimits* const limitsToUse = (hasLimits ? &requestLimits : nullptr);
+
+            const MemoryBlock& document = request.document;
+            MemoryInputStream in (document, false);
+
+            const bool isRtf = document.getSize() >= 5 && memcmp (document.getData(), "{\\rtf", 5) == 0;
+
+            AttributedString attributedString;
+            const bool loaded = isRtf ? AttributedStringSerializer::loadAttributedStringFromRTFData (in, attributedString, nullptr, limitsToUse, nullptr, &arena)
+                                      : AttributedStringSerializer::loadAttributedStringFromInputStream (in, attributedString, nullptr, limitsToUse, &arena);
+
+            if (! loaded)
+                error = requestLimits.wasExceeded() ? requestLimits.getErrorMessage() : String ("couldn't be read");
+            else if (request.kind == Kind::binary)
+                AttributedStringSerializer::writeAttributedStringToBinary (attributedString, response, true);
+            else
+                AttributedStringSerializer::writeAttributedStringToOutputStream (attributedString, response,
+                                                                                 request.kind == Kind::compressedXml);
+        }
+    }
+
+    ++numRequests;
+
+    if (error.isNotEmpty())
+    {
+        // nothing has been written after the header if it failed
+        response << error;
+        ++numFailed;
+    }
+
+    const int64 size = response.getPosition();
+    writeHeader (header, (uint32) (size - headerSize), request.id, (uint8) (error.isEmpty() ? Status::ok : Status::failed));
+
+    response.setPosition (0);
+    response.write (header, sizeof (header));
+    response.setPosition (size);
+}
+
+//==============================================================================
+bool ConversionServer::readFully (int fileDescriptor, void* destBuffer, size_t numBytes)
+{
+    char* dest = static_cast<char*> (destBuffer);
+
+    while (numBytes > 0)
+    {
+        const ssize_t numRead = ::read (fileDescriptor, dest, numBytes);
+
+        if (numRead < 0 && errno == EINTR)
+            continue;
+
+        if (numRead <= 0)
+            return false;
+
+        dest += numRead;
+        numBytes -= (size_t) numRead;
+    }
+
+    return true;
+}
+
+bool ConversionServer::writeFully (int fileDescriptor, const void* sourceBuffer, size_t numBytes)
+{
+    const char* source = static_cast<const char*> (sourceBuffer);
+
+    while (numBytes > 0)
+    {
+        const ssize_t numWritten = ::write (fileDescriptor, source, numBytes);
+
+        if (numWritten < 0 && errno == EINTR)
+            continue;
+
+        if (numWritten <= 0)
+            return false;
+
+        source += numWritten;
+        numBytes -= (size_t) numWritten;
+    }
+
+    return true;
+}
+
+void ConversionServer::writeHeader (uint8* dest, uint32 payloadSize, uint32 id, uint8 kindOrStatus) noexcept
+{
+    const uint32 length = ByteOrder::swapIfBigEndian ((uint32) (payloadSize + headerSize - 4));
+    const uint32 littleEndianId = ByteOrder::swapIfBigEndian (id);
+
+    memcpy (dest, &length, 4);
+    memcpy (dest + 4, &littleEndianId, 4);
+    dest[8] = kindOrStatus;
+}
@@ -0,0 +1,172 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/LoadLimits.h"
+
+class ParseArena;
+
+//==============================================================================
+/**
+    Collects the latencies of a series of requests and works out their percentiles.
+
+    It only keeps the most recent samples, so that a long-running server
+    doesn't grow without bound. All the methods may be called from several
+    threads at once.
+*/
+class LatencyRecorder
+{
+public:
+    LatencyRecorder() {}
+
+    void add (double seconds);
+    void reset();
+
+    struct Summary
+    {
+        int64 numSamples = 0;       // all of them, including the ones which are no longer kept
+        double median = 0, p90 = 0, p99 = 0, max = 0;   // in seconds, of the kept samples
+
+        /** e.g. "1000 requests, median 0.52 ms, 90% 0.81 ms, 99% 2.10 ms, max 4.44 ms" */
+        String toString() const;
+    };
+
+    Summary getSummary() const;
+
+private:
+    enum { maxNumKept = 65536 };
+
+    CriticalSection lock;
+    Array<double> samples;      // a ring buffer once it's full
+    int64 numSamples = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (LatencyRecorder)
+};
+
+//==============================================================================
+/**
+    Converts documents sent to it over a stream, so that a client which needs
+    many small conversions only pays for starting the process and warming up
+    the fonts once.
+
+    Requests and responses are frames which start with the number of bytes
+    which follow, so that any number of them can be sent down one stream. All
+    the numbers are 32-bit little-endian:
+
+        request:    length, id, kind (1 byte), document
+        response:   length, id, status (1 byte), converted document or error message
+
+    The document can be RTF, XML (possibly gzipped) or binary, as the loaders
+    recognise it by its first bytes. A client may send more requests before the
+    earlier ones have been answered: they are converted on a pool of threads and
+    answered as soon as they are done, so responses can come back in a different
+    order, and the id says which request each one belongs to.
+
+    A worker which takes a small request also takes the other small ones which
+    are waiting, up to a limit, and writes their responses together, so that a
+    burst of small requests doesn't cost a context switch and a write each.
+
+    The server uses POSIX file descriptors and sockets, which is all that the
+    converter's exporters need.
+*/
+class ConversionServer
+{
+public:
+    enum class Kind : uint8
+    {
+        xml             = 0,
+        compressedXml   = 1,
+        binary          = 2,    // with a paragraph index
+        statistics      = 255   // no document: the response is getStatistics() as text
+    };
+
+    enum class Status : uint8
+    {
+        ok              = 0,
+        failed          = 1     // the response holds the error message as UTF-8
+    };
+
+    /** The length field counts the id and kind or status too. */
+    enum { headerSize = 9, maxDocumentBytes = 64 * 1024 * 1024 };
+
+    explicit ConversionServer (int numThreads);
+    ~ConversionServer();
+
+    /** Makes every request load within these limits, for documents from untrusted
+        sources. Call this before serving.
+    */
+    void setLoadLimits (const LoadLimits& newLimits);
+
+    /** Serves the requests read from stdin, writing the responses to stdout,
+        until stdin is closed. Returns once every request has been answered.
+    */
+    void serveStandardStreams();
+
+    /** Listens on a Unix domain socket at the given path, replacing any socket
+        file which is already there, and serves every client which connects,
+        each on its own connection. This only returns if it can't listen.
+    */
+    Result serveUnixSocket (const File& socketFile);
+
+    struct Statistics
+    {
+        int64 numRequests = 0, numFailed = 0, numBatches = 0;
+        int64 numBytesRead = 0, numBytesWritten = 0;
+        LatencyRecorder::Summary latency;   // from a request being read to its response being written
+
+        String toString() const;
+    };
+
+    Statistics getStatistics() const;
+
+    //==============================================================================
+    /** Blocking reads and writes of a whole buffer, which fail if the other end has
+        closed the stream. These are shared with ConversionClient.
+    */
+    static bool readFully (int fileDescriptor, void* destBuffer, size_t numBytes);
+    static bool writeFully (int fileDescriptor, const void* sourceBuffer, size_t numBytes);
+
+    static void writeHeader (uint8* dest, uint32 payloadSize, uint32 id, uint8 kindOrStatus) noexcept;
+
+private:
+    //==============================================================================
+    class Connection;
+    class ConnectionReader;
+    class Worker;
+    struct Request;
+
+    void readRequests (Connection& connection);
+    void addRequest (Request* request);
+    bool takeBatch (OwnedArray<Request>& batch);
+    void processBatch (OwnedArray<Request>& batch, ParseArena& arena);
+    void convert (const Request& request, MemoryOutputStream& response, ParseArena& arena);
+    void removeFinishedReaders();
+
+    enum { smallRequestBytes = 64 * 1024, maxBatchSize = 32, maxQueuedBytes = 256 * 1024 * 1024 };
+
+    LoadLimits limits;
+    bool hasLimits = false;
+
+    CriticalSection queueLock;
+    OwnedArray<Request> queue;
+    int64 numQueuedBytes = 0;
+    WaitableEvent requestAdded, requestTaken;
+    bool isShuttingDown = false;
+
+    ThreadPool pool;
+    OwnedArray<Worker> workers;
+    OwnedArray<ConnectionReader> readers;
+
+    Atomic<int64> numRequests, numFailed, numBatches, numBytesRead, numBytesWritten;
+    LatencyRecorder latencies;
+
+    JUCE_DECLARE_NON_COPYABLE (ConversionServer)
+};
@@ -0,0 +1,460 @@
+/*
+  ==============================================================================
+
+    This file was auto-generated!
+
+    It contains the basic startup code for a Juce application.
+
+  ==============================================================================
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "BatchConverter.h"
+#include "ConversionCache.h"
+#include "ConversionServer.h"
+#include "ConversionClient.h"
+#include "../../Source/FontCache.h"
+#include "../../Source/SerializerStats.h"
+
+#include <iostream>
+
+//==============================================================================
+namespace
+{
+    struct Options
+    {
+        BatchConverter::OutputFormat format = BatchConverter::OutputFormat::xml;
+        File outputDirectory;
+        int numThreads = SystemStats::getNumCpus();
+        File cacheDirectory;
+        double watchInterval = 0;       // in seconds, or 0 to convert once and quit
+        bool recursive = false;
+        bool untrusted = false;
+        bool compress = false;
+        bool extractEmbedded = false;
+        bool parallelParse = false;
+        bool serve = false;
+        File serverSocket;              // or File() to serve stdin and stdout
+        File clientSocket;
+        int numRepeats = 1;
+        StringArray inputs;
+    };
+
+    static void printUsage()
+    {
+        std::cout << "Usage: RtfConverter [options] <file | directory | wildcard>..." << std::endl
+                  << "       RtfConverter --serve [<socket>] [--threads <n>] [--untrusted]" << std::endl
+                  << "       RtfConverter --client <socket> [--repeat <n>] [options] <file | directory | wildcard>..." << std::endl
+                  << std::endl
+                  << "Converts .rtf, .xml and .jasb files to the attributed string xml or binary format." << std::endl
+                  << std::endl
+                  << "  --to xml|binary     the output format (default: xml)" << std::endl
+                  << "  --output <dir>      where to put the converted files (default: next to the inputs)" << std::endl
+                  << "  --threads <n>       the number of files to convert at once (default: number of cpus)" << std::endl
+                  << "  --recursive         look for files in the sub-directories of directory arguments" << std::endl
+                  << "  --cache <dir>       keep track of the conversions in this directory, and only convert" << std::endl
+                  << "                      the files which have changed since" << std::endl
+                  << "  --watch [<secs>]    keep running and convert the files which change, looking for" << std::endl
+                  << "                      changes at this interval (default: 1)" << std::endl
+                  << "  --untrusted         reject files which are too large, too deeply nested or take" << std::endl
+                  << "                      too long to load, for files from unknown sources" << std::endl
+                  << "  --compress          gzip the xml outputs" << std::endl
+                  << "  --extract-embedded  write the pictures, objects and themes of rtf files to a" << std::endl
+                  << "                      <output name>-embedded directory next to each output" << std::endl
+                  << "  --parallel-parse    when there are fewer files than threads, split the rtf files" << std::endl
+                  << "                      between the spare threads" << std::endl
+                  << "  --serve [<socket>]  keep running and convert the documents sent to stdin, or to a" << std::endl
+                  << "                      Unix domain socket at this path, on a pool of threads" << std::endl
+                  << "  --client <socket>   send the files to a server listening on this socket, and report" << std::endl
+                  << "                      the latencies" << std::endl
+                  << "  --repeat <n>        the number of times the client sends each file (default: 1)" << std::endl;
+    }
+
+    static bool parseArguments (const StringArray& args, Options& options)
+    {
+        for (int i = 0; i < args.size(); ++i)
+        {
+            const String& arg = args[i];
+            const bool hasValue = (i + 1 < args.size());
+
+            if (arg == "--to" && hasValue)
+            {
+                const String value (args[++i]);
+
+                if      (value == "xml")    options.format = BatchConverter::OutputFormat::xml;
+                else if (value == "binary") options.format = BatchConverter::OutputFormat::binary;
+                else                        return false;
+            }
+            else if (arg == "--output" && hasValue)
+            {
+                options.outputDirectory = File::getCurrentWorkingDirectory().getChildFile (args[++i]);
+            }
+            else if (arg == "--threads" && hasValue)
+            {
+                options.numThreads = args[++i].getIntValue();
+
+                if (options.numThreads <= 0)
+                    return false;
+            }
+            else if (arg == "--cache" && hasValue)
+            {
+                options.cacheDirectory = File::getCurrentWorkingDirectory().getChildFile (args[++i]);
+            }
+            else if (arg == "--watch")
+            {
+                options.watchInterval = 1.0;
+
+                if (hasValue && args[i + 1].containsOnly ("0123456789."))
+                    options.watchInterval = args[++i].getDoubleValue();
+
+                if (options.watchInterval <= 0)
+                    return false;
+            }
+            else if (arg == "--recursive" || arg == "-r")
+            {
+                options.recursive = true;
+            }
+            else if (arg == "--untrusted")
+            {
+                options.untrusted = true;
+            }
+            else if (arg == "--compress")
+            {
+                options.compress = true;
+            }
+            else if (arg == "--extract-embedded")
+            {
+                options.extractEmbedded = true;
+            }
+            else if (arg == "--parallel-parse")
+            {
+                options.parallelParse = true;
+            }
+            else if (arg == "--serve")
+            {
+                options.serve = true;
+
+                if (hasValue && ! args[i + 1].startsWith ("-"))
+                    options.serverSocket = File::getCurrentWorkingDirectory().getChildFile (args[++i]);
+            }
+            else if (arg == "--client" && hasValue)
+            {
+                options.clientSocket = File::getCurrentWorkingDirectory().getChildFile (args[++i]);
+            }
+            else if (arg == "--repeat" && hasValue)
+            {
+                options.numRepeats = args[++i].getIntValue();
+
+                if (options.numRepeats <= 0)
+                    return false;
+            }
+            else if (arg.startsWith ("-"))
+            {
+                return false;
+            }
+            else
+            {
+                options.inputs.add (arg);
+            }
+        }
+
+        // a server reads its documents from its clients
+        return options.serve ? options.inputs.isEmpty()
+                             : ! options.inputs.isEmpty();
+    }
+
+    //==============================================================================
+    // Expands an argument into the files it names, along with the directory
+    // which they were found in.
+    static bool findInputFiles (const Options& options, const String& arg, Array<File>& files, File& root,
+                                bool reportMissingInputs)
+    {
+        const File argFile (File::getCurrentWorkingDirectory().getChildFile (arg));
+
+        if (argFile.isDirectory())
+        {
+            root = argFile;
+            root.findChildFiles (files, File::findFiles, options.recursive, "*.rtf;*.xml;*.jasb");
+        }
+        else if (argFile.getFileName().containsAnyOf ("*?"))
+        {
+            root = argFile.getParentDirectory();
+            root.findChildFiles (files, File::findFiles, false, argFile.getFileName());
+        }
+        else if (argFile.existsAsFile())
+        {
+            root = argFile.getParentDirectory();
+            files.add (argFile);
+        }
+        else
+        {
+            if (reportMissingInputs)
+                std::cerr << "No such file or directory: " << arg << std::endl;
+
+            return false;
+        }
+
+        files.sort();
+        return true;
+    }
+
+    // Expands the arguments into jobs. The path of a file found in a directory (or
+    // by a wildcard) is kept relative to that directory inside the output directory.
+    static bool createJobs (const Options& options, Array<BatchConverter::Job>& jobs, bool reportMissingInputs = true)
+    {
+        const String extension (BatchConverter::getFileExtension (options.format));
+        bool ok = true;
+
+        for (auto& arg : options.inputs)
+        {
+            File root;
+            Array<File> files;
+
+            if (! findInputFiles (options, arg, files, root, reportMissingInputs))
+            {
+                ok = false;
+                continue;
+            }
+
+            for (auto& file : files)
+            {
+                BatchConverter::Job job;
+                job.input = file;
+                job.output = (options.outputDirectory != File() ? options.outputDirectory.getChildFile (file.getRelativePathFrom (root))
+                                                                : file).withFileExtension (extension);
+
+                // a file which is already in the output format would be converted onto itself,
+                // which is pointless and, when watching, would never stop changing
+                if (job.output != job.input)
+                    jobs.add (job);
+            }
+        }
+
+        return ok;
+    }
+
+    //==============================================================================
+    static String formatThroughput (int64 numBytes, double seconds)
+    {
+        return String (seconds > 0 ? numBytes / (seconds * 1024.0 * 1024.0) : 0.0, 2) + " MB/s";
+    }
+
+    static int printResults (const Array<BatchConverter::Job>& jobs, const Array<BatchConverter::Result>& results, double seconds)
+    {
+        int64 totalRead = 0, totalWritten = 0;
+        int numFailed = 0, numRestored = 0, numUpToDate = 0;
+
+        for (int i = 0; i < jobs.size(); ++i)
+        {
+            const BatchConverter::Job& job = jobs.getReference (i);
+            const BatchConverter::Result& result = results.getReference (i);
+
+            if (result.error.isNotEmpty())
+            {
+                std::cerr << job.input.getFullPathName() << ": " << result.error << std::endl;
+                ++numFailed;
+                continue;
+            }
+
+            if (result.action == BatchConverter::Result::Action::upToDate)
+            {
+                ++numUpToDate;
+                continue;
+            }
+
+            totalRead += result.numBytesRead;
+            totalWritten += result.numBytesWritten;
+
+            if (result.action == BatchConverter::Result::Action::restoredFromCache)
+            {
+                std::cout << job.input.getFullPathName() << " -> " << job.output.getFullPathName() << "  (from the cache)" << std::endl;
+                ++numRestored;
+                continue;
+            }
+
+            std::cout << job.input.getFullPathName() << " -> " << job.output.getFullPathName()
+                      << "  " << File::descriptionOfSizeInBytes (result.numBytesRead)
+                      << ", " << String (result.seconds * 1000.0, 2) << " ms"
+                      << ", " << formatThroughput (result.numBytesRead, result.seconds);
+
+            if (result.numEmbeddedFiles > 0)
+                std::cout << ", " << result.numEmbeddedFiles << " embedded files";
+
+            std::cout << std::endl;
+        }
+
+        const int numConverted = jobs.size() - numFailed - numRestored - numUpToDate;
+
+        std::cout << std::endl
+                  << "Converted " << numConverted << " of " << jobs.size() << " files"
+                  << " (" << File::descriptionOfSizeInBytes (totalRead) << " -> " << File::descriptionOfSizeInBytes (totalWritten) << ")"
+                  << " in " << String (seconds, 3) << " s: "
+                  << formatThroughput (totalRead, seconds) << ", "
+                  << String (seconds > 0 ? numConverted / seconds : 0.0, 1) << " files/s" << std::endl;
+
+        if (numRestored + numUpToDate > 0)
+            std::cout << numRestored << " restored from the cache, " << numUpToDate << " up to date" << std::endl;
+
+        const FontCache::Statistics fonts (FontCache::getInstance()->getStatistics());
+
+        std::cout << "Font cache: " << fonts.numFonts << " fonts, " << fonts.numHits << " hits, "
+                  << fonts.numMisses << " misses, " << fonts.numEvictions << " evictions" << std::endl;
+
+        if (SerializerStats::isEnabled())
+        {
+            // these are summed over the worker threads, so the time can exceed the wall clock's
+            std::cout << "Serializer: " << SerializerStats::getTotals().toString() << std::endl;
+            SerializerStats::resetTotals();
+        }
+
+        return numFailed == 0 ? 0 : 1;
+    }
+
+    //==============================================================================
+    // Looks at the inputs' modification times at regular intervals, as a stand-in for
+    // file system notifications, and converts the ones which have been added or have
+    // changed since the last look. The first look converts everything which isn't
+    // up to date. This only stops when the process is killed.
+    static void watch (const Options& options, BatchConverter& converter, ConversionCache& cache)
+    {
+        HashMap<String, int64> lastModificationTimes;
+
+        for (bool isFirstLook = true;; isFirstLook = false)
+        {
+            Array<BatchConverter::Job> jobs, changedJobs;
+            createJobs (options, jobs, isFirstLook);
+
+            for (auto& job : jobs)
+            {
+                const String path (job.input.getFullPathName());
+                const int64 time = job.input.getLastModificationTime().toMilliseconds();
+
+                if (! lastModificationTimes.contains (path) || lastModificationTimes[path] != time)
+                {
+                    lastModificationTimes.set (path, time);
+                    changedJobs.add (job);
+                }
+            }
+
+            if (! changedJobs.isEmpty())
+            {
+                const int64 startTicks = Time::getHighResolutionTicks();
+                const Array<BatchConverter::Result> results (converter.run (changedJobs, options.numThreads));
+                const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+
+                printResults (changedJobs, results, seconds);
+                cache.save();
+
+                std::cout << std::endl << "Watching for changes..." << std::endl;
+            }
+
+            Thread::sleep (roundToInt (options.watchInterval * 1000.0));
+        }
+    }
+
+    //==============================================================================
+    // When serving stdin, stdout carries the responses, so everything else goes to stderr.
+    static int serve (const Options& options)
+    {
+        ConversionServer server (options.numThreads);
+
+        if (options.untrusted)
+            server.setLoadLimits (LoadLimits::forUntrustedInput());
+
+        if (options.serverSocket == File())
+        {
+            server.serveStandardStreams();
+            std::cerr << "Served " << server.getStatistics().toString() << std::endl;
+            return 0;
+        }
+
+        std::cerr << "Listening on " << options.serverSocket.getFullPathName() << std::endl;
+
+        const Result result (server.serveUnixSocket (options.serverSocket));
+        std::cerr << result.getErrorMessage() << std::endl;
+        return 1;
+    }
+
+    static int runClient (const Options& options)
+    {
+        Array<File> inputs;
+
+        for (auto& arg : options.inputs)
+        {
+            File root;
+
+            if (! findInputFiles (options, arg, inputs, root, true))
+                return 1;
+        }
+
+        const ConversionServer::Kind kind = (options.format == BatchConverter::OutputFormat::binary ? ConversionServer::Kind::binary
+                                              : options.compress ? ConversionServer::Kind::compressedXml
+                                                                 : ConversionServer::Kind::xml);
+
+        return ConversionClient::runHarness (options.clientSocket, inputs, kind, options.numThreads, options.numRepeats);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    StringArray args;
+
+    for (int i = 1; i < argc; ++i)
+        args.add (CharPointer_UTF8 (argv[i]));
+
+    Options options;
+
+    if (! parseArguments (args, options))
+    {
+        printUsage();
+        return 2;
+    }
+
+    if (options.serve)
+        return serve (options);
+
+    if (options.clientSocket != File())
+        return runClient (options);
+
+    // the cache would restore an output without its embedded files
+    if (options.extractEmbedded && options.cacheDirectory != File())
+    {
+        std::cerr << "--extract-embedded can't be used with --cache" << std::endl;
+        return 2;
+    }
+
+    ScopedPointer<ConversionCache> cache;
+
+    // watching needs to know what it has converted, even if that isn't kept for next time
+    if (options.cacheDirectory != File() || options.watchInterval > 0)
+    {
+        // compressed outputs have the same extension, so they have to be kept apart like this
+        cache = new ConversionCache (options.cacheDirectory,
+                                     String (BatchConverter::version) + (options.compress ? "-gz" : ""));
+    }
+
+    BatchConverter converter (options.format, cache);
+    converter.setCompressesXml (options.compress);
+    converter.setExtractsEmbeddedData (options.extractEmbedded);
+    converter.setParsesInParallel (options.parallelParse);
+
+    if (options.untrusted)
+        converter.setLoadLimits (LoadLimits::forUntrustedInput());
+
+    if (options.watchInterval > 0)
+    {
+        watch (options, converter, *cache);
+        return 0;
+    }
+
+    Array<BatchConverter::Job> jobs;
+    const bool allInputsFound = createJobs (options, jobs);
+
+    const int64 startTicks = Time::getHighResolutionTicks();
+    const Array<BatchConverter::Result> results (converter.run (jobs, options.numThreads));
+    const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+
+    const int status = printResults (jobs, results, seconds);
+    return allInputsFound ? status : 1;
+}
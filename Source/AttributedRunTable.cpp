@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "AttributedRunTable.h"
+#include "AttributedStringBuilder.h"
+
+AttributedRunTable::AttributedRunTable (const AttributedString& source)
+{
+    assign (source);
+}
+
+void AttributedRunTable::assign (const AttributedString& source)
+{
+    clear();
+
+    text = source.getText();
+    textLength = text.length();
+    justification = source.getJustification();
+    wordWrap = source.getWordWrap();
+    readingDirection = source.getReadingDirection();
+    lineSpacing = source.getLineSpacing();
+
+    const int n = source.getNumAttributes();
+
+    runStarts.ensureStorageAllocated (n);
+    fontIndexes.ensureStorageAllocated (n);
+    colours.ensureStorageAllocated (n);
+
+    writeAll (source, *this);
+}
+
+void AttributedRunTable::clear() noexcept
+{
+    text.clear();
+    textLength = nextRunStart = 0;
+
+    runStarts.clearQuick();
+    fontIndexes.clearQuick();
+    colours.clearQuick();
+    fonts.clear();
+
+    justification = Justification::left;
+    wordWrap = AttributedString::byWord;
+    readingDirection = AttributedString::natural;
+    lineSpacing = 0.0f;
+}
+
+AttributedString AttributedRunTable::toAttributedString() const
+{
+    AttributedString result;
+    result.setJustification (justification);
+    result.setWordWrap (wordWrap);
+    result.setReadingDirection (readingDirection);
+    result.setLineSpacing (lineSpacing);
+
+    // a single pass over the text, as substring() would count from the start for every run
+    String::CharPointerType p (text.getCharPointer());
+    AttributedStringBuilder builder (result);
+
+    for (int i = 0; i < runStarts.size(); ++i)
+    {
+        const char* const start = p.getAddress();
+
+        for (int num = getRunRange (i).getLength(); --num >= 0;)
+            ++p;
+
+        const Colour colour (colours.getUnchecked (i));
+        builder.append (start, (size_t) (p.getAddress() - start), &fonts.getReference (fontIndexes.getUnchecked (i)), &colour);
+    }
+
+    builder.flush();
+    return result;
+}
+
+//==============================================================================
+Range<int> AttributedRunTable::getRunRange (int runIndex) const noexcept
+{
+    return { runStarts[runIndex], runIndex + 1 < runStarts.size() ? runStarts.getUnchecked (runIndex + 1) : textLength };
+}
+
+int AttributedRunTable::findRun (int characterIndex) const noexcept
+{
+    if (! isPositiveAndBelow (characterIndex, textLength))
+        return -1;
+
+    // the last run which starts at or before the character
+    const int* const starts = runStarts.begin();
+    return (int) (std::upper_bound (starts, starts + runStarts.size(), characterIndex) - starts) - 1;
+}
+
+Range<int> AttributedRunTable::findRuns (Range<int> characterRange) const noexcept
+{
+    const Range<int> clipped (characterRange.getIntersectionWith (Range<int> (0, textLength)));
+
+    if (clipped.isEmpty())
+        return {};
+
+    return { findRun (clipped.getStart()), findRun (clipped.getEnd() - 1) + 1 };
+}
+
+const Font* AttributedRunTable::getFontAt (int characterIndex) const noexcept
+{
+    const int run = findRun (characterIndex);
+    return run >= 0 ? &fonts.getReference (fontIndexes.getUnchecked (run)) : nullptr;
+}
+
+Colour AttributedRunTable::getColourAt (int characterIndex) const noexcept
+{
+    const int run = findRun (characterIndex);
+    return run >= 0 ? Colour (colours.getUnchecked (run)) : Colour (0xff000000);
+}
+
+//==============================================================================
+void AttributedRunTable::writeRun (const char* utf8, size_t numBytes, const Font& font, Colour colour)
+{
+    runStarts.add (nextRunStart);
+    fontIndexes.add (fonts.findOrAdd (font));
+    colours.add (colour.getARGB());
+
+    nextRunStart += (int) CharPointer_UTF8 (utf8).lengthUpTo (CharPointer_UTF8 (utf8 + numBytes));
+}
@@ -0,0 +1,93 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "AttributedRunWriter.h"
+#include "FontTable.h"
+
+//==============================================================================
+/**
+    The runs of an attributed string as parallel arrays, for answering "what is
+    the font or colour at this character" quickly.
+
+    An AttributedString keeps a whole Font in every attribute and can only be
+    searched from the start. Here the runs are three arrays of run starts,
+    indexes into a table with each distinct font once, and ARGB colours, so
+    findRun() is a binary search over the starts, which stay in the cache even
+    with hundreds of thousands of runs.
+
+    The runs cover the whole text without gaps: any text which the source has
+    no attribute for gets the font and colour of the run before it, as
+    AttributedString::append() would give it.
+*/
+class AttributedRunTable  : private AttributedRunWriter
+{
+public:
+    AttributedRunTable() noexcept {}
+    explicit AttributedRunTable (const AttributedString& source);
+
+    /** Replaces the runs with those of another string, keeping the memory the
+        arrays have already allocated, so that a table which is reused for one
+        document after another soon stops allocating.
+    */
+    void assign (const AttributedString& source);
+
+    /** Empties the table, keeping its memory for the next assign(). */
+    void clear() noexcept;
+
+    /** Creates an AttributedString with the same text, runs and layout settings. */
+    AttributedString toAttributedString() const;
+
+    //==============================================================================
+    const String& getText() const noexcept              { return text; }
+    int getTextLength() const noexcept                  { return textLength; }
+
+    int getNumRuns() const noexcept                     { return runStarts.size(); }
+    Range<int> getRunRange (int runIndex) const noexcept;
+    int getRunFontIndex (int runIndex) const noexcept   { return fontIndexes[runIndex]; }
+    Colour getRunColour (int runIndex) const noexcept   { return Colour (colours[runIndex]); }
+
+    int getNumFonts() const noexcept                    { return fonts.size(); }
+    const Font& getFont (int fontIndex) const noexcept  { return fonts.getReference (fontIndex); }
+
+    //==============================================================================
+    /** Returns the run which the character is in, or -1 if it's outside the text. */
+    int findRun (int characterIndex) const noexcept;
+
+    /** Returns the indexes of the runs which overlap a range of characters, so
+        that they can be iterated with a plain loop.
+    */
+    Range<int> findRuns (Range<int> characterRange) const noexcept;
+
+    /** The font and colour which the character is drawn with, or nullptr and
+        black if it's outside the text.
+    */
+    const Font* getFontAt (int characterIndex) const noexcept;
+    Colour getColourAt (int characterIndex) const noexcept;
+
+private:
+    //==============================================================================
+    void writeRun (const char* utf8, size_t numBytes, const Font& font, Colour colour) override;
+    void finish() override {}
+
+    String text;
+    int textLength = 0, nextRunStart = 0;
+
+    Array<int> runStarts, fontIndexes;
+    Array<uint32> colours;
+    FontTable fonts;
+
+    Justification justification { Justification::left };
+    AttributedString::WordWrap wordWrap = AttributedString::byWord;
+    AttributedString::ReadingDirection readingDirection = AttributedString::natural;
+    float lineSpacing = 0.0f;
+
+    JUCE_LEAK_DETECTOR (AttributedRunTable)
+};
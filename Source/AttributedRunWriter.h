@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    Writes a document which is handed to it one run at a time, so that it can
+    be written while it's still being loaded: see ExportPipeline.
+
+    Each run is a stretch of text in a single font and colour, in order, and
+    its UTF-8 text is only valid during the call. finish() is called once after
+    the last run, and should write anything which is still buffered.
+*/
+class AttributedRunWriter
+{
+public:
+    virtual ~AttributedRunWriter() {}
+
+    virtual void writeRun (const char* utf8, size_t numBytes, const Font& font, Colour colour) = 0;
+    virtual void finish() = 0;
+
+    /** Hands the runs of a whole string to a writer, without calling finish().
+
+        The runs cover the text without gaps: any text which the string has no
+        attribute for goes with the font and colour of the run before it, as
+        AttributedString::append() would give it.
+    */
+    static void writeAll (const AttributedString& source, AttributedRunWriter& writer)
+    {
+        const String& text = source.getText();
+        const int textLength = text.length();
+        CharPointer_UTF8 p (text.toRawUTF8());
+
+        Font font;
+        Colour colour (0xff000000);
+        int pos = 0;
+
+        for (int i = 0; i < source.getNumAttributes() && pos < textLength; ++i)
+        {
+            const AttributedString::Attribute& attr = source.getAttribute (i);
+            const Range<int> range (attr.range.getIntersectionWith (Range<int> (pos, textLength)));
+
+            if (range.isEmpty())
+                continue;
+
+            if (range.getStart() > pos)
+                writeCharacters (writer, p, range.getStart() - pos, font, colour);
+
+            font = attr.font;
+            colour = attr.colour;
+            writeCharacters (writer, p, range.getLength(), font, colour);
+            pos = range.getEnd();
+        }
+
+        if (pos < textLength)
+            writeCharacters (writer, p, textLength - pos, font, colour);
+    }
+
+private:
+    static void writeCharacters (AttributedRunWriter& writer, CharPointer_UTF8& p, int numCharacters,
+                                 const Font& font, Colour colour)
+    {
+        const char* const start = p.getAddress();
+
+        while (--numCharacters >= 0)
+            ++p;
+
+        writer.writeRun (start, (size_t) (p.getAddress() - start), font, colour);
+    }
+};
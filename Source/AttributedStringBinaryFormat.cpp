@@ -0,0 +1,489 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "AttributedStringBinaryFormat.h"
+#include "AttributedStringBuilder.h"
+#include "FontCache.h"
+#include "FontTable.h"
+#include "SerializerStats.h"
+#include "LoadLimits.h"
+
+namespace
+{
+    const char magic[] = { 'J', 'A', 'S', 'B' };
+    const char indexMagic[] = { 'J', 'A', 'S', 'I' };
+
+    enum
+    {
+        headerSize = 24,
+        runRecordSize = 16,
+        fontRecordSize = 16,
+        indexHeaderSize = 8,
+        indexRecordSize = 8
+    };
+
+    static uint32 readWord (const char* p) noexcept
+    {
+        return ByteOrder::littleEndianInt (p);
+    }
+
+    static uint32 paddedSize (uint32 numBytes) noexcept
+    {
+        return (numBytes + 3u) & ~3u;
+    }
+
+    static bool isContinuationByte (const char* text, uint32 offset, uint32 textSize) noexcept
+    {
+        return offset < textSize && (((uint8) text[offset]) & 0xc0) == 0x80;
+    }
+
+    //==============================================================================
+    class BinaryWriter
+    {
+    public:
+        BinaryWriter (const AttributedString& s, bool shouldIncludeIndex)
+            : attrStr (s), text (s.getText()), cursor (text.getCharPointer()), includeIndex (shouldIncludeIndex)
+        {
+        }
+
+        void write (OutputStream& out)
+        {
+            collectRuns();
+
+            ATTRIBUTED_STRING_STATS_PHASE (writingOutput);
+           #if ATTRIBUTED_STRING_STATS
+            const int64 startPosition = out.getPosition();
+           #endif
+
+            out.write (magic, sizeof (magic));
+            out.writeInt ((int) AttributedStringBinaryFormat::currentVersion);
+            out.writeInt (runs.size());
+            out.writeInt (fonts.size());
+            out.writeInt ((int) names.getDataSize());
+            out.writeInt ((int) text.getNumBytesAsUTF8());
+
+            for (auto& run : runs)
+            {
+                out.writeInt ((int) run.start);
+                out.writeInt ((int) run.length);
+                out.writeInt ((int) run.fontIndex);
+                out.writeInt ((int) run.argb);
+            }
+
+            uint32 nameOffset = 0;
+
+            for (auto& font : fonts)
+            {
+                const float height = font.getHeight();
+                uint32 heightBits;
+                memcpy (&heightBits, &height, sizeof (heightBits));
+
+                const uint32 nameLength = (uint32) font.getTypefaceName().getNumBytesAsUTF8();
+
+                out.writeInt ((int) nameOffset);
+                out.writeInt ((int) nameLength);
+                out.writeInt ((int) heightBits);
+                out.writeInt (font.getStyleFlags());
+
+                nameOffset += nameLength;
+            }
+
+            out.write (names.getData(), names.getDataSize());
+            out.writeRepeatedByte (0, paddedSize ((uint32) names.getDataSize()) - (uint32) names.getDataSize());
+
+            out.write (text.toRawUTF8(), text.getNumBytesAsUTF8());
+
+            if (includeIndex)
+                writeParagraphIndex (out);
+
+            ATTRIBUTED_STRING_STATS_ADD (numBytesWritten, out.getPosition() - startPosition);
+        }
+
+    private:
+        struct RunRecord
+        {
+            uint32 start, length, fontIndex, argb;
+        };
+
+        void collectRuns()
+        {
+            const int n = attrStr.getNumAttributes();
+            runs.ensureStorageAllocated (n);
+
+            for (int i = 0; i < n; ++i)
+            {
+                const AttributedString::Attribute& attr = attrStr.getAttribute (i);
+
+                if (attr.range.isEmpty())
+                    continue;
+
+                RunRecord run;
+                run.start = getByteOffset (attr.range.getStart());
+                run.length = getByteOffset (attr.range.getEnd()) - run.start;
+                run.fontIndex = (uint32) findOrAddFont (attr.font);
+                run.argb = attr.colour.getARGB();
+
+                if (run.length > 0)
+                    runs.add (run);
+            }
+        }
+
+        uint32 getByteOffset (int index)
+        {
+            if (index < cursorIndex)
+            {
+                cursor = text.getCharPointer();
+                cursorIndex = 0;
+            }
+
+            while (cursorIndex < index && ! cursor.isEmpty())
+            {
+                ++cursor;
+                ++cursorIndex;
+            }
+
+            return (uint32) (cursor.getAddress() - text.toRawUTF8());
+        }
+
+        void writeParagraphIndex (OutputStream& out)
+        {
+            const char* const utf8 = text.toRawUTF8();
+            const uint32 textSize = (uint32) text.getNumBytesAsUTF8();
+
+            // byte and character offset pairs
+            Array<uint32> entries;
+            uint32 numCharacters = 0;
+            bool isParagraphStart = true;
+
+            for (uint32 i = 0; i < textSize; ++i)
+            {
+                if (isParagraphStart)
+                {
+                    entries.add (i);
+                    entries.add (numCharacters);
+                    isParagraphStart = false;
+                }
+
+                const uint8 c = (uint8) utf8[i];
+
+                if ((c & 0xc0) != 0x80)
+                    ++numCharacters;
+
+                if (c == '\n')
+                    isParagraphStart = true;
+            }
+
+            out.writeRepeatedByte (0, paddedSize (textSize) - textSize);
+            out.write (indexMagic, sizeof (indexMagic));
+            out.writeInt (entries.size() / 2);
+
+            for (auto entry : entries)
+                out.writeInt ((int) entry);
+
+            out.writeInt ((int) textSize);
+            out.writeInt ((int) numCharacters);
+        }
+
+        int findOrAddFont (const Font& font)
+        {
+            const int numFonts = fonts.size();
+            const int index = fonts.findOrAdd (font);
+
+            if (index == numFonts)
+            {
+                const String& family = font.getTypefaceName();
+                names.write (family.toRawUTF8(), family.getNumBytesAsUTF8());
+            }
+
+            return index;
+        }
+
+        const AttributedString& attrStr;
+        const String& text;
+
+        String::CharPointerType cursor;
+        int cursorIndex = 0;
+
+        Array<RunRecord> runs;
+        FontTable fonts;
+        MemoryOutputStream names;
+        const bool includeIndex;
+
+        JUCE_DECLARE_NON_COPYABLE (BinaryWriter)
+    };
+
+    //==============================================================================
+    class BinaryReader
+    {
+    public:
+        BinaryReader (const void* d, size_t size)
+            : data (static_cast<const char*> (d)), dataSize (size)
+        {
+        }
+
+        bool read (AttributedString& result, LoadLimits* limits)
+        {
+            if (! readHeader() || ! CharPointer_UTF8::isValidString (text, (int) textSize))
+                return false;
+
+            // the header says how large the result will be before anything is built
+            if (limits != nullptr && ! limits->checkOutputSize (numRuns, textSize))
+                return false;
+
+            return readFonts() && readText (result, 0, textSize, 0);
+        }
+
+        int getNumParagraphs()
+        {
+            return readHeader() && readIndex() ? (int) numParagraphs : -1;
+        }
+
+        AttributedString* readParagraphs (int firstParagraph, int numParagraphsToRead,
+                                          int* characterOffset, bool* hasParagraphIndex)
+        {
+            const bool hasIndex = readHeader() && readIndex();
+
+            if (hasParagraphIndex != nullptr)
+                *hasParagraphIndex = hasIndex;
+
+            if (! hasIndex || ! readFonts())
+                return nullptr;
+
+            const uint32 first = (uint32) jlimit (0, (int) numParagraphs, firstParagraph);
+            const uint32 end   = (uint32) jlimit ((int) first, (int) numParagraphs, firstParagraph + jmax (0, numParagraphsToRead));
+
+            const uint32 startByte = readWord (paragraphs + first * indexRecordSize);
+            const uint32 endByte   = readWord (paragraphs + end * indexRecordSize);
+
+            // only the slice's own text is checked, so that this doesn't get slower
+            // as the rest of the document grows
+            if (! isParagraphStart (startByte) || ! isParagraphStart (endByte) || startByte > endByte
+                 || ! CharPointer_UTF8::isValidString (text + startByte, (int) (endByte - startByte)))
+                return nullptr;
+
+            if (characterOffset != nullptr)
+                *characterOffset = (int) readWord (paragraphs + first * indexRecordSize + 4);
+
+            ScopedPointer<AttributedString> result (new AttributedString);
+
+            if (startByte < endByte && ! readText (*result, startByte, endByte, findFirstRunEndingAfter (startByte)))
+                return nullptr;
+
+            return result.release();
+        }
+
+    private:
+        // The runs' text goes straight from the data into the builder, which
+        // appends it to the result without re-merging everything for each run
+        bool readText (AttributedString& result, uint32 textStart, uint32 textEnd, uint32 firstRun)
+        {
+            AttributedStringBuilder builder (result);
+            const char* const runData = data + headerSize;
+            uint32 pos = textStart, previousRunEnd = 0;
+
+            for (uint32 i = firstRun; i < numRuns; ++i)
+            {
+                const char* const record = runData + i * runRecordSize;
+                const uint32 start     = readWord (record);
+                const uint32 length    = readWord (record + 4);
+                const uint32 fontIndex = readWord (record + 8);
+
+                if (start < previousRunEnd || start > textSize || length == 0 || length > textSize - start || fontIndex >= numFonts
+                     || isContinuationByte (text, start, textSize)
+                     || isContinuationByte (text, start + length, textSize))
+                    return false;
+
+                if (start >= textEnd)
+                    break;
+
+                previousRunEnd = start + length;
+
+                const uint32 runStart = jmax (start, textStart);
+                const uint32 runEnd = jmin (previousRunEnd, textEnd);
+
+                if (runStart > pos)
+                    builder.append (text + pos, runStart - pos, nullptr, nullptr);
+
+                const Colour colour (readWord (record + 12));
+                builder.append (text + runStart, runEnd - runStart, &fonts.getReference ((int) fontIndex), &colour);
+
+                pos = runEnd;
+            }
+
+            if (pos < textEnd)
+                builder.append (text + pos, textEnd - pos, nullptr, nullptr);
+
+            builder.flush();
+            return true;
+        }
+
+        // the runs are in text order, so this doesn't need to look at the ones before
+        uint32 findFirstRunEndingAfter (uint32 offset) const noexcept
+        {
+            const char* const runData = data + headerSize;
+            uint32 low = 0, high = numRuns;
+
+            while (low < high)
+            {
+                const uint32 mid = low + (high - low) / 2;
+                const char* const record = runData + mid * runRecordSize;
+
+                if ((uint64) readWord (record) + readWord (record + 4) <= offset)
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+
+            return low;
+        }
+
+        bool readHeader()
+        {
+            if (! AttributedStringBinaryFormat::isBinaryData (data, dataSize) || dataSize < headerSize)
+                return false;
+
+            const uint32 version = readWord (data + 4);
+
+            if (version == 0 || version > AttributedStringBinaryFormat::currentVersion)
+                return false;
+
+            numRuns   = readWord (data + 8);
+            numFonts  = readWord (data + 12);
+            namesSize = readWord (data + 16);
+            textSize  = readWord (data + 20);
+
+            const uint64 namesStart = headerSize + (uint64) numRuns * runRecordSize + (uint64) numFonts * fontRecordSize;
+            const uint64 textStart = namesStart + paddedSize (namesSize);
+
+            if (namesSize > 0xfffffffc || textSize > 0x7fffffff || textStart + textSize > dataSize)
+                return false;
+
+            names = data + namesStart;
+            text = data + textStart;
+            textEndOffset = textStart + textSize;
+            return true;
+        }
+
+        bool readIndex()
+        {
+            const uint64 indexStart = (textEndOffset + 3) & ~(uint64) 3;
+
+            if (indexStart + indexHeaderSize > dataSize || memcmp (data + indexStart, indexMagic, sizeof (indexMagic)) != 0)
+                return false;
+
+            numParagraphs = readWord (data + indexStart + 4);
+
+            if (numParagraphs > 0x7ffffffe
+                 || indexStart + indexHeaderSize + ((uint64) numParagraphs + 1) * indexRecordSize > dataSize)
+                return false;
+
+            paragraphs = data + indexStart + indexHeaderSize;
+            return true;
+        }
+
+        bool isParagraphStart (uint32 offset) const noexcept
+        {
+            return offset == 0 || offset == textSize || (offset < textSize && text[offset - 1] == '\n');
+        }
+
+        bool readFonts()
+        {
+            const char* const fontData = data + headerSize + (size_t) numRuns * runRecordSize;
+            fonts.ensureStorageAllocated ((int) numFonts);
+
+            for (uint32 i = 0; i < numFonts; ++i)
+            {
+                const char* const record = fontData + i * fontRecordSize;
+                const uint32 nameOffset = readWord (record);
+                const uint32 nameLength = readWord (record + 4);
+                const uint32 heightBits = readWord (record + 8);
+
+                if (nameOffset > namesSize || nameLength > namesSize - nameOffset
+                     || ! CharPointer_UTF8::isValidString (names + nameOffset, (int) nameLength))
+                    return false;
+
+                float height;
+                memcpy (&height, &heightBits, sizeof (height));
+
+                const String family (CharPointer_UTF8 (names + nameOffset), CharPointer_UTF8 (names + nameOffset + nameLength));
+                fonts.add (FontCache::getInstance()->getFont (family, height, (int) readWord (record + 12)));
+            }
+
+            return true;
+        }
+
+        const char* const data;
+        const size_t dataSize;
+
+        uint32 numRuns = 0, numFonts = 0, namesSize = 0, textSize = 0, numParagraphs = 0;
+        uint64 textEndOffset = 0;
+        const char* names = nullptr;
+        const char* text = nullptr;
+        const char* paragraphs = nullptr;
+        Array<Font> fonts;
+
+        JUCE_DECLARE_NON_COPYABLE (BinaryReader)
+    };
+}
+
+//==============================================================================
+bool AttributedStringBinaryFormat::isBinaryData (const void* data, size_t numBytes) noexcept
+{
+    return numBytes >= sizeof (magic) && memcmp (data, magic, sizeof (magic)) == 0;
+}
+
+AttributedString* AttributedStringBinaryFormat::read (const void* data, size_t numBytes, LoadLimits* limits)
+{
+    ScopedPointer<AttributedString> result (new AttributedString);
+    return read (data, numBytes, *result, limits) ? result.release() : nullptr;
+}
+
+bool AttributedStringBinaryFormat::read (const void* data, size_t numBytes, AttributedString& result, LoadLimits* limits)
+{
+    ATTRIBUTED_STRING_STATS_ADD (numBytesRead, (int64) numBytes);
+
+    AttributedStringBuilder::resetTarget (result);
+
+    if (limits != nullptr)
+    {
+        limits->loadStarted();
+
+        if (! limits->checkInputSize ((int64) numBytes))
+            return false;
+    }
+
+    BinaryReader reader (data, numBytes);
+
+    if (reader.read (result, limits))
+        return true;
+
+    AttributedStringBuilder::resetTarget (result);
+    return false;
+}
+
+void AttributedStringBinaryFormat::write (const AttributedString& attributedString, OutputStream& stream,
+                                          bool includeParagraphIndex)
+{
+    BinaryWriter writer (attributedString, includeParagraphIndex);
+    writer.write (stream);
+}
+
+int AttributedStringBinaryFormat::getNumParagraphs (const void* data, size_t numBytes)
+{
+    BinaryReader reader (data, numBytes);
+    return reader.getNumParagraphs();
+}
+
+AttributedString* AttributedStringBinaryFormat::readParagraphs (const void* data, size_t numBytes,
+                                                                int firstParagraph, int numParagraphs,
+                                                                int* characterOffset, bool* hasParagraphIndex)
+{
+    BinaryReader reader (data, numBytes);
+    return reader.readParagraphs (firstParagraph, numParagraphs, characterOffset, hasParagraphIndex);
+}
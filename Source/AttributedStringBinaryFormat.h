@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+class LoadLimits;
+
+//==============================================================================
+/**
+    A compact binary alternative to the XML format.
+
+    All values are little-endian 32-bit words and every section starts on a
+    4-byte boundary, so the data can be used exactly where it lies, e.g. in a
+    MemoryMappedFile. The layout is:
+
+        header      magic "JASB", version, number of runs, number of fonts,
+                    size of the name pool in bytes, size of the text in bytes
+        runs        { byte offset into the text, length in bytes, font index, ARGB }
+        fonts       { byte offset into the name pool, length in bytes, height (float bits), style flags }
+        name pool   the UTF-8 family names, padded to a multiple of 4 bytes
+        text        the whole string as UTF-8
+        index       optional, after padding the text to a multiple of 4 bytes:
+                    magic "JASI", number of paragraphs, then
+                    { byte offset into the text, character offset } for each
+                    paragraph, and once more for the end of the text
+
+    Fonts are deduplicated, so the font table only has one entry for every
+    distinct family, height and style. The runs are stored in text order and
+    point straight into the text with byte offsets, so a reader can take each
+    run's text from where it lies without searching for it or converting it.
+
+    A paragraph is the text up to and including a newline, or up to the end. The
+    index lets readParagraphs() go straight to any of them. Readers which don't
+    know about it ignore it.
+*/
+struct AttributedStringBinaryFormat
+{
+    enum { currentVersion = 1 };
+
+    /** True if the data starts with the format's magic number. */
+    static bool isBinaryData (const void* data, size_t numBytes) noexcept;
+
+    /** Returns nullptr if the data isn't valid, or if it exceeds the LoadLimits.
+        The number of runs stands in for the number of attributes.
+    */
+    static AttributedString* read (const void* data, size_t numBytes, LoadLimits* limits = nullptr);
+
+    /** Reads into an existing AttributedString, replacing what it held, and returns
+        false where the other version returns nullptr, leaving the string empty.
+    */
+    static bool read (const void* data, size_t numBytes, AttributedString& result, LoadLimits* limits = nullptr);
+
+    static void write (const AttributedString& attributedString, OutputStream& stream,
+                       bool includeParagraphIndex = false);
+
+    //==============================================================================
+    /** Returns -1 if the data isn't valid or has no paragraph index. */
+    static int getNumParagraphs (const void* data, size_t numBytes);
+
+    /** Reads only the given paragraphs, which are clipped to the ones there are,
+        without looking at the text of the others.
+
+        If characterOffset isn't nullptr, it is set to the index of the first
+        character read within the whole text. If hasParagraphIndex isn't nullptr,
+        it is set to whether the data has a header and an index to read from, so
+        that a caller can tell when to fall back to reading it all. Returns nullptr
+        if the data isn't valid or has no paragraph index.
+    */
+    static AttributedString* readParagraphs (const void* data, size_t numBytes,
+                                             int firstParagraph, int numParagraphs,
+                                             int* characterOffset = nullptr,
+                                             bool* hasParagraphIndex = nullptr);
+};
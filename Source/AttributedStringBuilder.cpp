@@ -0,0 +1,171 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "AttributedStringBuilder.h"
+#include "AttributedRunWriter.h"
+#include "SerializerStats.h"
+
+// Small enough that appending a run to the piece being filled is cheap, and
+// big enough that there aren't many joins
+static const int runsPerPiece = 128;
+
+AttributedStringBuilder::AttributedStringBuilder (AttributedString& s, ParseArena* arena)
+    : target (s), pendingText (arena), currentColour (0xff000000),
+      numAttributesFlushed (s.getNumAttributes())
+{
+    // start off with whatever AttributedString::append would inherit
+    if (numAttributesFlushed > 0)
+    {
+        const AttributedString::Attribute& last = target.getAttribute (numAttributesFlushed - 1);
+        currentFont = last.font;
+        currentColour = last.colour;
+    }
+
+    pendingFont = flushedFont = currentFont;
+    pendingColour = flushedColour = currentColour;
+}
+
+void AttributedStringBuilder::resetTarget (AttributedString& s)
+{
+    s.clear();
+    s.setJustification (Justification::left);
+    s.setWordWrap (AttributedString::byWord);
+    s.setReadingDirection (AttributedString::natural);
+    s.setLineSpacing (0.0f);
+}
+
+void AttributedStringBuilder::append (const char* utf8, size_t numBytes, const Font* font, const Colour* colour)
+{
+    if (font != nullptr && *font != currentFont)
+    {
+        currentFont = *font;
+        formatChanged = true;
+    }
+
+    if (colour != nullptr && *colour != currentColour)
+    {
+        currentColour = *colour;
+        formatChanged = true;
+    }
+
+    if (numBytes == 0)
+        return;
+
+    // the pending run only takes on the new format once some text arrives in it
+    if (formatChanged)
+    {
+        if (currentFont != pendingFont || currentColour != pendingColour)
+        {
+            flushPendingRun();
+            pendingFont = currentFont;
+            pendingColour = currentColour;
+        }
+
+        formatChanged = false;
+    }
+
+    pendingText.append (utf8, numBytes);
+    numTextBytes += (int64) numBytes;
+    ++numRunsAppended;
+    ATTRIBUTED_STRING_STATS_ADD (numRunsAppended, 1);
+}
+
+void AttributedStringBuilder::append (const String& text, const Font* font, const Colour* colour)
+{
+    append (text.toRawUTF8(), text.getNumBytesAsUTF8(), font, colour);
+}
+
+AttributedString AttributedStringBuilder::createSnapshot() const
+{
+    AttributedString snapshot (target);
+
+    for (auto* piece : pieces)
+        snapshot.append (*piece);
+
+    if (lastPiece != nullptr)
+        snapshot.append (*lastPiece);
+
+    if (! pendingText.isEmpty())
+        snapshot.append (pendingText.toString(), pendingFont, pendingColour);
+
+    return snapshot;
+}
+
+void AttributedStringBuilder::flush()
+{
+    flushPendingRun();
+    joinPieces();
+}
+
+void AttributedStringBuilder::flushPendingRun()
+{
+    if (pendingText.isEmpty())
+        return;
+
+    ATTRIBUTED_STRING_STATS_PHASE (appendingRuns);
+
+    // only a run which follows an explicit flush() can have the same format as the last one
+    if (numAttributesFlushed == 0 || pendingFont != flushedFont || pendingColour != flushedColour)
+    {
+        ++numAttributesFlushed;
+        ATTRIBUTED_STRING_STATS_ADD (numAttributesCreated, 1);
+    }
+
+    flushedFont = pendingFont;
+    flushedColour = pendingColour;
+
+    if (runWriter != nullptr)
+    {
+        runWriter->writeRun (pendingText.getData(), pendingText.getSize(), pendingFont, pendingColour);
+        pendingText.clear();
+        return;
+    }
+
+    if (lastPiece == nullptr)
+        lastPiece = new AttributedString();
+
+    lastPiece->append (pendingText.toString(), pendingFont, pendingColour);
+    pendingText.clear();
+
+    if (lastPiece->getNumAttributes() >= runsPerPiece)
+    {
+        pieces.add (lastPiece.release());
+
+        // like carrying in a binary counter: the pieces which get joined are always
+        // made of the same number of filled pieces
+        for (int n = ++numPiecesFilled; (n & 1) == 0; n >>= 1)
+        {
+            const int last = pieces.size() - 1;
+            pieces.getUnchecked (last - 1)->append (*pieces.getUnchecked (last));
+            pieces.removeLast();
+        }
+    }
+}
+
+void AttributedStringBuilder::joinPieces()
+{
+    if (lastPiece != nullptr)
+        pieces.add (lastPiece.release());
+
+    if (pieces.size() == 0)
+        return;
+
+    ATTRIBUTED_STRING_STATS_PHASE (appendingRuns);
+
+    // the pieces get smaller towards the end, so join them from there
+    for (int last = pieces.size(); --last > 0;)
+    {
+        pieces.getUnchecked (last - 1)->append (*pieces.getUnchecked (last));
+        pieces.removeLast();
+    }
+
+    target.append (*pieces.getUnchecked (0));
+    pieces.clear();
+    numPiecesFilled = 0;
+}
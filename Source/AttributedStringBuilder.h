@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Utf8Buffer.h"
+
+class AttributedRunWriter;
+
+//==============================================================================
+/**
+    Appends runs of text to an AttributedString, merging consecutive runs which
+    end up with the same font and colour into a single attribute.
+
+    A run which doesn't specify a font or a colour inherits it from the run
+    before it, just like AttributedString::append does. The text of the current
+    run is collected in a reusable buffer and is only turned into a String when
+    text arrives in a different format, so don't forget to call flush() at the
+    end. Formatting which changes and changes back before any text arrives
+    doesn't split the run.
+
+    AttributedString::append copies the whole text and re-merges every attribute,
+    so appending each run to the target would make a load quadratic in the number
+    of runs. Instead the runs are gathered into small pieces, and pieces of the
+    same size are joined as they fill up, so each run is only copied a
+    logarithmic number of times before flush() joins them onto the target.
+
+    Given an AttributedRunWriter, the builder hands each run to it instead of
+    appending it to the target, so that a loader can stream a document without
+    ever holding all of it.
+*/
+class AttributedStringBuilder
+{
+public:
+    /** The pending run's buffer comes from the arena, if there is one. */
+    AttributedStringBuilder (AttributedString& target, ParseArena* arena = nullptr);
+
+    /** Empties a string which is about to be loaded into and puts its layout
+        settings back to the defaults, so that the loaders leave it just as they
+        would leave a new one.
+    */
+    static void resetTarget (AttributedString& target);
+
+    void append (const char* utf8, size_t numBytes, const Font* font, const Colour* colour);
+    void append (const String& text, const Font* font, const Colour* colour);
+
+    /** Appends everything to the target, or hands the pending run to the run writer. */
+    void flush();
+
+    /** Makes flush() hand the runs to this writer, which the builder doesn't own,
+        rather than append them to the target. Its finish() isn't called.
+    */
+    void setRunWriter (AttributedRunWriter* newWriter) noexcept    { runWriter = newWriter; }
+
+    /** Returns a copy of everything appended so far, including the pending run,
+        without flushing it.
+    */
+    AttributedString createSnapshot() const;
+
+    /** The number of non-empty runs passed to append(). */
+    int getNumRunsAppended() const noexcept         { return numRunsAppended; }
+
+    /** The number of attributes the target will have once the pending run has
+        been flushed (or the number of runs the writer will have been given), and
+        the number of bytes of text passed to append().
+    */
+    int getNumAttributes() const noexcept           { return numAttributesFlushed + (pendingText.isEmpty() ? 0 : 1); }
+    int64 getNumTextBytes() const noexcept          { return numTextBytes; }
+
+private:
+    AttributedString& target;
+    AttributedRunWriter* runWriter = nullptr;
+    Utf8Buffer pendingText;
+    Font currentFont, pendingFont, flushedFont;     // the last ones asked for, the pending run's and the last run's
+    Colour currentColour, pendingColour, flushedColour;
+    bool formatChanged = false;
+    int numAttributesFlushed, numRunsAppended = 0;
+    int64 numTextBytes = 0;
+
+    // runs which have been flushed but not yet joined onto the target, in order,
+    // in pieces which get smaller towards the end, followed by the one being filled
+    OwnedArray<AttributedString> pieces;
+    ScopedPointer<AttributedString> lastPiece;
+    int numPiecesFilled = 0;
+
+    void flushPendingRun();
+    void joinPieces();
+
+    JUCE_DECLARE_NON_COPYABLE (AttributedStringBuilder)
+};
@@ -12,208 +12,449 @@
 #endif
 
 #include "AttributedStringSerializer.h"
+#include "AttributedStringXmlReader.h"
+#include "AttributedStringXmlWriter.h"
+#include "RtfParser.h"
+#include "AttributedStringBuilder.h"
+#include "AttributedStringBinaryFormat.h"
+#include "FontCache.h"
+#include "SerializerStats.h"
+#include "PeekableInputStream.h"
+#include "LoadLimits.h"
+#include "AttributedRunTable.h"
+#include "TextTranscoding.h"
 
 #if (! (JUCE_IOS || JUCE_MAC) || defined(__OBJC__))
 
-static void addTextToXml (XmlElement& parent, const String& str)
+namespace
 {
-    int n = str.length();
-    int len = 0;
+    bool isGzipData (const char* data, int numBytes) noexcept
+    {
+        return numBytes >= 2 && (uint8) data[0] == 0x1f && (uint8) data[1] == 0x8b;
+    }
 
-    for (int pos = 0; pos < n; pos += len)
+    // the stream's first four bytes must have been peeked already
+    bool loadXmlOrBinary (PeekableInputStream& stream, AttributedString& result, LoadProgress* progress,
+                          LoadLimits* limits, ParseArena* arena)
     {
-        int bpos = str.indexOfChar (pos, L'\n');
-        len = (bpos >= 0 ? bpos - pos : n - pos);
+        if (! AttributedStringBinaryFormat::isBinaryData (stream.getPeekedData(), (size_t) stream.peek (4)))
+            return AttributedStringXmlReader::parse (stream, result, progress, limits, arena);
 
-        if (len  > 0) parent.addTextElement (str.substring (pos, pos + len));
+        // the binary format can only be read from memory
+        MemoryBlock data;
+        const int64 maxInputBytes = (limits != nullptr ? limits->maxInputBytes : 0);
 
-        if (bpos >= 0)
-        {
-            parent.createNewChildElement ("br");
-            pos++;
-        }
+        stream.readIntoMemoryBlock (data, maxInputBytes > 0 ? (ssize_t) maxInputBytes + 1 : -1);
+        return AttributedStringBinaryFormat::read (data.getData(), data.getSize(), result, limits);
+    }
+
+    // the create functions are the load functions with a new string to load into
+    template <typename LoadFunction>
+    AttributedString* createByLoading (LoadFunction load)
+    {
+        ScopedPointer<AttributedString> result (new AttributedString);
+        return load (*result) ? result.release() : nullptr;
     }
 }
 
-void AttributedStringSerializer::writeAttributedStringToOutputStream (const AttributedString& attrStr, OutputStream& stream)
+void AttributedStringSerializer::writeAttributedStringToOutputStream (const AttributedString& attrStr, OutputStream& stream,
+                                                                      bool compress)
 {
-    static Identifier sizeIdentifier   ("size");
-    static Identifier familyIdentifier ("family");
-    static Identifier syleIdentifier   ("style");
-    static Identifier colourIdentifier ("colour");
+    ATTRIBUTED_STRING_STATS_CALL();
 
-    XmlElement root ("JUCE");
+    if (compress)
+    {
+        // these window bits make zlib write a gzip header, which the loaders recognise
+        GZIPCompressorOutputStream compressor (&stream, -1, false, 15 + 16);
+        AttributedStringXmlWriter::write (attrStr, compressor);
+        compressor.flush();
+        return;
+    }
 
-    const int n = attrStr.getNumAttributes();
-    int pos = 0;
+    AttributedStringXmlWriter::write (attrStr, stream);
+}
+
+AttributedString* AttributedStringSerializer::createAttributedStringFromInputStream (InputStream& stream, LoadProgress* progress,
+                                                                                  LoadLimits* limits)
+{
+    return createByLoading ([&] (AttributedString& result) { return loadAttributedStringFromInputStream (stream, result, progress, limits); });
+}
+
+bool AttributedStringSerializer::loadAttributedStringFromInputStream (InputStream& stream, AttributedString& result,
+                                                                      LoadProgress* progress, LoadLimits* limits, ParseArena* arena)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
 
-    const String& str = attrStr.getText();
+    PeekableInputStream in (stream);
 
-    for (int i = 0; i < n; ++i)
+    if (isGzipData (in.getPeekedData(), in.peek (4)))
     {
-        const AttributedString::Attribute& attr = attrStr.getAttribute (i);
+        // this decompresses a small chunk at a time, as the reader asks for it
+        GZIPDecompressorInputStream decompressor (&in, false, GZIPDecompressorInputStream::gzipFormat);
+        PeekableInputStream decompressed (decompressor);
 
-        if (pos < attr.range.getStart())
-        {
-            addTextToXml (root, str.substring (pos, attr.range.getStart()));
-            pos = attr.range.getStart();
-        }
+        return loadXmlOrBinary (decompressed, result, progress, limits, arena);
+    }
 
-        XmlElement* font = root.createNewChildElement ("font");
+    return loadXmlOrBinary (in, result, progress, limits, arena);
+}
 
-        font->setAttribute (sizeIdentifier,   static_cast<double> (attr.font.getHeight()));
-        font->setAttribute (familyIdentifier, attr.font.getTypefaceName());
+AttributedString* AttributedStringSerializer::createAttributedStringFromFile (const File& inputFile, LoadProgress* progress,
+                                                                           LoadLimits* limits)
+{
+    return createByLoading ([&] (AttributedString& result) { return loadAttributedStringFromFile (inputFile, result, progress, limits); });
+}
 
-        StringArray styles;
+bool AttributedStringSerializer::loadAttributedStringFromFile (const File& inputFile, AttributedString& result,
+                                                               LoadProgress* progress, LoadLimits* limits, ParseArena* arena)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
 
-        const int styleFlags = attr.font.getStyleFlags();
+    ScopedPointer<InputStream> inputStream = inputFile.createInputStream();
 
-        if ((styleFlags & Font::bold)       != 0) styles.add ("bold");
-        if ((styleFlags & Font::italic)     != 0) styles.add ("italic");
-        if ((styleFlags & Font::underlined) != 0) styles.add ("underlined");
+    if (inputStream == nullptr)
+    {
+        AttributedStringBuilder::resetTarget (result);
+        return false;
+    }
 
-        if (styles.size() > 0)
-            font->setAttribute (syleIdentifier, styles.joinIntoString (","));
+    // binary files can be loaded through the XML entry points too
+    char header[4];
 
-        String red   (String::toHexString ((int) attr.colour.getRed()));
-        String green (String::toHexString ((int) attr.colour.getGreen()));
-        String blue  (String::toHexString ((int) attr.colour.getBlue()));
+    if (inputStream->read (header, sizeof (header)) == (int) sizeof (header)
+         && AttributedStringBinaryFormat::isBinaryData (header, sizeof (header)))
+        return loadAttributedStringFromBinaryFile (inputFile, result, limits);
 
-        if (red  .length() < 2) red   = String ("0") + red;
-        if (green.length() < 2) green = String ("0") + green;
-        if (blue .length() < 2) blue  = String ("0") + blue;
+    inputStream->setPosition (0);
+    return loadAttributedStringFromInputStream (*inputStream, result, progress, limits, arena);
+}
 
-        font->setAttribute (colourIdentifier, String ("#") + red + green + blue);
-        addTextToXml (*font, str.substring (attr.range.getStart(), attr.range.getEnd()));
+void AttributedStringSerializer::writeAttributedStringToFile (const AttributedString& str, const File& outFile, bool compress)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
 
-        pos = attr.range.getEnd() + 1;
-    }
+    ScopedPointer<OutputStream> outputStream = outFile.createOutputStream();
 
-    root.writeToStream (stream, "");
+    if (outputStream != nullptr)
+        return writeAttributedStringToOutputStream (str, *outputStream, compress);
 }
 
-AttributedString* AttributedStringSerializer::createAttributedStringFromInputStream (InputStream& stream)
+AttributedString* AttributedStringSerializer::createAttributedStringFromBinary (const void* data, size_t numBytes, LoadLimits* limits)
 {
-    static Identifier sizeIdentifier   ("size");
-    static Identifier familyIdentifier ("family");
-    static Identifier syleIdentifier   ("style");
-    static Identifier colourIdentifier ("colour");
+    ATTRIBUTED_STRING_STATS_CALL();
 
-    XmlDocument xmlDocument (stream.readString());
+    return AttributedStringBinaryFormat::read (data, numBytes, limits);
+}
+
+void AttributedStringSerializer::writeAttributedStringToBinary (const AttributedString& str, OutputStream& stream, bool includeParagraphIndex)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
+
+    AttributedStringBinaryFormat::write (str, stream, includeParagraphIndex);
+}
+
+bool AttributedStringSerializer::loadAttributedStringFromBinary (const void* data, size_t numBytes, AttributedString& result,
+                                                                 LoadLimits* limits)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
+
+    return AttributedStringBinaryFormat::read (data, numBytes, result, limits);
+}
+
+AttributedString* AttributedStringSerializer::createAttributedStringFromBinaryFile (const File& binaryFile, LoadLimits* limits)
+{
+    return createByLoading ([&] (AttributedString& result) { return loadAttributedStringFromBinaryFile (binaryFile, result, limits); });
+}
+
+bool AttributedStringSerializer::loadAttributedStringFromBinaryFile (const File& binaryFile, AttributedString& result, LoadLimits* limits)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
+
+    MemoryMappedFile mappedFile (binaryFile, MemoryMappedFile::readOnly);
+
+    if (mappedFile.getData() != nullptr)
+        return loadAttributedStringFromBinary (mappedFile.getData(), mappedFile.getSize(), result, limits);
+
+    AttributedStringBuilder::resetTarget (result);
+    return false;
+}
+
+void AttributedStringSerializer::writeAttributedStringToBinaryFile (const AttributedString& str, const File& outFile, bool includeParagraphIndex)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
+
+    ScopedPointer<OutputStream> outputStream = outFile.createOutputStream();
+
+    if (outputStream != nullptr)
+        writeAttributedStringToBinary (str, *outputStream, includeParagraphIndex);
+}
+
+AttributedString* AttributedStringSerializer::createAttributedStringFromFileRange (const File& file, int firstParagraph, int numParagraphs)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
 
-    ScopedPointer<XmlElement> xml = xmlDocument.getDocumentElement();
-    if (xml != nullptr)
     {
-        ScopedPointer<AttributedString> result = new AttributedString;
+        MemoryMappedFile mappedFile (file, MemoryMappedFile::readOnly);
 
-        forEachXmlChildElement (*xml, xmlElement)
+        if (mappedFile.getData() != nullptr)
         {
-            if (xmlElement->isTextElement())
-            {
-                result->append (xmlElement->getText());
-            }
-            else if (xmlElement->hasTagName ("br"))
-            {
-                result->append ("\n");
-            }
-            else if (xmlElement->hasTagName ("font"))
-            {
-                const float  size   = static_cast<float> (xmlElement->getDoubleAttribute (sizeIdentifier, 12.0));
-                const String family = xmlElement->getStringAttribute (familyIdentifier, "");
-                const StringArray styleTags = StringArray::fromTokens (xmlElement->getStringAttribute (syleIdentifier, ""), ",", "");
-                const String colourString = xmlElement->getStringAttribute (colourIdentifier, "");
+            bool hasParagraphIndex = false;
+            ScopedPointer<AttributedString> result (AttributedStringBinaryFormat::readParagraphs (mappedFile.getData(), mappedFile.getSize(),
+                                                                                                  firstParagraph, numParagraphs,
+                                                                                                  nullptr, &hasParagraphIndex));
 
-                int styleFlags = 0;
+            if (hasParagraphIndex)
+                return result.release();
+        }
+    }
 
-                if (styleTags.contains ("bold"))       styleFlags |= Font::bold;
-                if (styleTags.contains ("italic"))     styleFlags |= Font::italic;
-                if (styleTags.contains ("underlined")) styleFlags |= Font::underlined;
+    ScopedPointer<AttributedString> whole (file.hasFileExtension ("rtf") ? createAttributedStringFromRTFFile (file)
+                                                                         : createAttributedStringFromFile (file));
 
-                Colour colour = Colours::transparentBlack;
+    if (whole == nullptr)
+        return nullptr;
 
-                if (colourString.startsWith ("#") && colourString.length() == 7)
-                {
-                    const String red   (colourString.substring (1, 3));
-                    const String green (colourString.substring (3, 5));
-                    const String blue  (colourString.substring (5, 7));
+    // find where the paragraphs start and end, as character indexes
+    const String& text = whole->getText();
+    String::CharPointerType p (text.getCharPointer());
+    int index = 0, paragraph = 0, start = -1;
+    const int lastParagraph = firstParagraph + jmax (0, numParagraphs);
 
-                    colour = Colour ((uint8) red.getHexValue32(), (uint8) green.getHexValue32(), (uint8) blue.getHexValue32());
-                }
+    if (firstParagraph <= 0)
+        start = 0;
 
-                forEachXmlChildElement (*xmlElement, textElement)
-                {
-                    String subtext;
+    while (! p.isEmpty() && paragraph < lastParagraph)
+    {
+        ++index;
 
-                    if      (textElement->isTextElement())   subtext += textElement->getText();
-                    else if (textElement->hasTagName ("br")) subtext += "\n";
+        if (p.getAndAdvance() == '\n' && ++paragraph == firstParagraph)
+            start = index;
+    }
 
-                    if      (colour.getAlpha() != 0 && family.isNotEmpty()) result->append (subtext, Font (family, size, styleFlags), colour);
-                    else if (colour.getAlpha() != 0)                        result->append (subtext, colour);
-                    else if (                          family.isNotEmpty()) result->append (subtext, Font (family, size, styleFlags));
-                    else                                                    result->append (subtext);
-                }
-            }
-        }
+    ScopedPointer<AttributedString> result (new AttributedString);
+    result->setJustification (whole->getJustification());
+    result->setWordWrap (whole->getWordWrap());
+    result->setReadingDirection (whole->getReadingDirection());
+    result->setLineSpacing (whole->getLineSpacing());
 
+    if (start < 0 || numParagraphs <= 0)
         return result.release();
+
+    // a single pass over the text, as substring() would count from the start every time
+    String::CharPointerType q (text.getCharPointer());
+    int pos = 0;
+
+    auto takeTextUpTo = [&q, &pos] (int end)
+    {
+        const String::CharPointerType begin (q);
+
+        for (; pos < end; ++pos)
+            ++q;
+
+        return String (begin, q);
+    };
+
+    takeTextUpTo (start);
+
+    for (int i = 0; i < whole->getNumAttributes(); ++i)
+    {
+        const AttributedString::Attribute& attr = whole->getAttribute (i);
+        const Range<int> overlap (attr.range.getIntersectionWith (Range<int> (pos, index)));
+
+        if (overlap.isEmpty())
+            continue;
+
+        // like the binary reader, this keeps any text which no attribute covers
+        if (overlap.getStart() > pos)
+            result->append (takeTextUpTo (overlap.getStart()));
+
+        result->append (takeTextUpTo (overlap.getEnd()), attr.font, attr.colour);
     }
 
-    return nullptr;
+    if (pos < index)
+        result->append (takeTextUpTo (index));
+
+    return result.release();
 }
 
-AttributedString* AttributedStringSerializer::createAttributedStringFromFile (const File& inputFile)
+AttributedString* AttributedStringSerializer::createAttributedStringFromRTFFile (const File& rtfFile, LoadProgress* progress,
+                                                                              LoadLimits* limits,
+                                                                              EmbeddedDataHandler* embeddedData)
 {
-    ScopedPointer<InputStream> inputStream = inputFile.createInputStream();
+    return createByLoading ([&] (AttributedString& result)
+    {
+        return loadAttributedStringFromRTFFile (rtfFile, result, progress, limits, embeddedData);
+    });
+}
+
+bool AttributedStringSerializer::loadAttributedStringFromRTFFile (const File& rtfFile, AttributedString& result,
+                                                                  LoadProgress* progress, LoadLimits* limits,
+                                                                  EmbeddedDataHandler* embeddedData, ParseArena* arena)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
+
+    ScopedPointer<InputStream> inputStream = rtfFile.createInputStream();
 
     if (inputStream != nullptr)
-        return createAttributedStringFromInputStream (*inputStream);
+        return loadAttributedStringFromRTFData (*inputStream, result, progress, limits, embeddedData, arena);
 
-    return nullptr;
+    AttributedStringBuilder::resetTarget (result);
+    return false;
 }
 
-void AttributedStringSerializer::writeAttributedStringToFile (const AttributedString& str, const File& outFile)
+AttributedString* AttributedStringSerializer::createAttributedStringFromRTFData (InputStream& inputStream, LoadProgress* progress,
+                                                                              LoadLimits* limits,
+                                                                              EmbeddedDataHandler* embeddedData)
 {
-    ScopedPointer<OutputStream> outputStream = outFile.createOutputStream();
+    ATTRIBUTED_STRING_STATS_CALL();
 
-    if (outputStream != nullptr)
-        return writeAttributedStringToOutputStream (str, *outputStream);
+    return RtfParser::parse (inputStream, progress, limits, embeddedData);
 }
 
-#if (JUCE_MAC || JUCE_IOS)
-AttributedString* AttributedStringSerializer::createAttributedStringFromRTFFile (const File& rtfFile)
+bool AttributedStringSerializer::loadAttributedStringFromRTFData (InputStream& inputStream, AttributedString& result,
+                                                                  LoadProgress* progress, LoadLimits* limits,
+                                                                  EmbeddedDataHandler* embeddedData, ParseArena* arena)
 {
-    ScopedPointer<InputStream> inputStream = rtfFile.createInputStream();
+    ATTRIBUTED_STRING_STATS_CALL();
 
-    if (inputStream != nullptr)
-        return createAttributedStringFromRTFData (*inputStream);
+    return RtfParser::parse (inputStream, result, progress, limits, embeddedData, arena);
+}
+
+AttributedString* AttributedStringSerializer::createAttributedStringFromRTFDataInParallel (const void* data, size_t numBytes, int numThreads)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
+
+    return RtfParser::parseInParallel (data, numBytes, numThreads);
+}
+
+AttributedString* AttributedStringSerializer::createAttributedStringFromRTFFileInParallel (const File& rtfFile, int numThreads)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
+
+    MemoryMappedFile mappedFile (rtfFile, MemoryMappedFile::readOnly);
+
+    if (mappedFile.getData() != nullptr)
+        return createAttributedStringFromRTFDataInParallel (mappedFile.getData(), mappedFile.getSize(), numThreads);
 
     return nullptr;
 }
 
-AttributedString* AttributedStringSerializer::createAttributedStringFromRTFData (InputStream& inputStream)
+AttributedRunTable* AttributedStringSerializer::createRunTableFromFile (const File& file, LoadProgress* progress,
+                                                                    LoadLimits* limits)
 {
+    ATTRIBUTED_STRING_STATS_CALL();
+
+    const ScopedPointer<AttributedString> str (file.hasFileExtension ("rtf") ? createAttributedStringFromRTFFile (file, progress, limits)
+                                                                             : createAttributedStringFromFile (file, progress, limits));
+
+    return str != nullptr ? new AttributedRunTable (*str) : nullptr;
+}
+
+bool AttributedStringSerializer::loadRunTableFromFile (const File& file, AttributedRunTable& result, LoadProgress* progress,
+                                                       LoadLimits* limits, ParseArena* arena)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
+
+    AttributedString str;
+
+    if (file.hasFileExtension ("rtf") ? loadAttributedStringFromRTFFile (file, str, progress, limits, nullptr, arena)
+                                      : loadAttributedStringFromFile (file, str, progress, limits, arena))
+    {
+        result.assign (str);
+        return true;
+    }
+
+    result.clear();
+    return false;
+}
+
+AttributedStringSerializer::CoalesceResult AttributedStringSerializer::coalesceRuns (AttributedString& str)
+{
+    CoalesceResult result;
+    result.numAttributesBefore = str.getNumAttributes();
+
+    AttributedString merged;
+    merged.setJustification (str.getJustification());
+    merged.setWordWrap (str.getWordWrap());
+    merged.setReadingDirection (str.getReadingDirection());
+    merged.setLineSpacing (str.getLineSpacing());
+
+    {
+        const String text (str.getText());
+        String::CharPointerType p (text.getCharPointer());
+        int index = 0;
+
+        AttributedStringBuilder builder (merged);
+
+        for (int i = 0; i < result.numAttributesBefore; ++i)
+        {
+            const AttributedString::Attribute& attr = str.getAttribute (i);
+            const char* start = p.getAddress();
+
+            // text which isn't covered by any attribute keeps whatever it would inherit
+            for (; index < attr.range.getStart() && ! p.isEmpty(); ++index)
+                ++p;
+
+            builder.append (start, (size_t) (p.getAddress() - start), nullptr, nullptr);
+            start = p.getAddress();
+
+            for (; index < attr.range.getEnd() && ! p.isEmpty(); ++index)
+                ++p;
+
+            builder.append (start, (size_t) (p.getAddress() - start), &attr.font, &attr.colour);
+        }
+
+        builder.append (p.getAddress(), strlen (p.getAddress()), nullptr, nullptr);
+        builder.flush();
+    }
+
+    str = merged;
+    result.numAttributesAfter = str.getNumAttributes();
+    return result;
+}
+
+#if (JUCE_MAC || JUCE_IOS)
+AttributedString* AttributedStringSerializer::createAttributedStringFromRTFDataUsingCocoa (InputStream& inputStream)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
+
     MemoryBlock rtfData;
 
-    if (inputStream.readIntoMemoryBlock (rtfData) <= 0)
-        return nullptr;
+    {
+        ATTRIBUTED_STRING_STATS_PHASE (readingInput);
 
+        if (inputStream.readIntoMemoryBlock (rtfData) <= 0)
+            return nullptr;
+    }
 
+    ATTRIBUTED_STRING_STATS_ADD (numBytesRead, (int64) rtfData.getSize());
 
     if (NSData* nsRTFData = [[NSData alloc] initWithBytes:rtfData.getData() length:rtfData.getSize()])
     {
-        NSAttributedString* attr = [[NSAttributedString alloc] initWithRTF:nsRTFData documentAttributes:nullptr];
+        NSAttributedString* attr;
+
+        {
+            ATTRIBUTED_STRING_STATS_PHASE (cocoaImport);
+            attr = [[NSAttributedString alloc] initWithRTF:nsRTFData documentAttributes:nullptr];
+        }
+
         [nsRTFData release];
 
         if (attr != nullptr)
         {
             ScopedPointer<AttributedString> juceAttr = new AttributedString;
+            AttributedStringBuilder builder (*juceAttr);
 
             NSUInteger pos = 0, n = [attr length];
 
             NSRange range;
 
-
+            // each run's UTF-16 is copied out and converted here, rather than
+            // having an NSString and a C string made for it
             NSString* nsText = [attr string];
+            HeapBlock<unichar> utf16;
+            NSUInteger utf16Size = 0;
+            Utf8Buffer utf8;
 
             while (pos < n)
             {
@@ -255,7 +496,7 @@ AttributedString* AttributedStringSerializer::createAttributedStringFromRTFData
                                             }
 
 
-                                            font = new Font (Font (fontFamily, 12, style).withPointHeight ([fontDescriptor pointSize]));
+                                            font = new Font (FontCache::getInstance()->getFontWithPointHeight (fontFamily, (float) [fontDescriptor pointSize], style));
                                         }
                                     }
                                 }
@@ -273,17 +514,24 @@ AttributedString* AttributedStringSerializer::createAttributedStringFromRTFData
                     }
                 }
 
-                String text = juce::CharPointer_UTF8 ([[nsText substringWithRange:range] cStringUsingEncoding:NSUTF8StringEncoding]);
+                if (range.length > utf16Size)
+                {
+                    utf16Size = jmax (range.length, utf16Size * 2);
+                    utf16.realloc ((size_t) utf16Size);
+                }
+
+                [nsText getCharacters:utf16.getData() range:range];
+
+                utf8.clear();
+                TextTranscoding::appendUtf16 (utf8, reinterpret_cast<const uint16*> (utf16.getData()), (size_t) range.length);
 
-                if      (font != nullptr && colour != nullptr) juceAttr->append (text, *font, *colour);
-                else if (font != nullptr)                      juceAttr->append (text, *font);
-                else if                    (colour != nullptr) juceAttr->append (text, *colour);
-                else                                           juceAttr->append (text);
+                builder.append (utf8.getData(), utf8.getSize(), font.get(), colour.get());
 
                 pos = range.location + range.length;
             }
 
             [attr release];
+            builder.flush();
             return juceAttr.release();
         }
     }
@@ -10,18 +10,136 @@
 
 #pragma once
 
-#include "../JuceLibraryCode/JuceHeader.h"
+#include "JuceHeader.h"
+
+class LoadProgress;
+class LoadLimits;
+class AttributedRunTable;
+class EmbeddedDataHandler;
+class ParseArena;
 
 struct AttributedStringSerializer
 {
-    static AttributedString* createAttributedStringFromInputStream (InputStream& stream);
-    static void writeAttributedStringToOutputStream (const AttributedString& str, OutputStream& stream);
+    /** The loaders which read a stream can report their progress to a LoadProgress,
+        which can also cancel them. Binary files are loaded in one go, so they
+        don't report any progress.
+
+        For documents from untrusted sources, pass LoadLimits (e.g.
+        LoadLimits::forUntrustedInput()): a document which exceeds them makes
+        the loader stop early and return nullptr, and the LoadLimits say which
+        limit it was. The parallel and Cocoa RTF loaders don't take any limits.
+
+        The XML can be written gzip-compressed, which makes it many times smaller.
+        These loaders tell from the first bytes whether a stream or file is
+        compressed, and whether it's XML or binary, and decompress it a chunk at
+        a time as they read it.
+    */
+    static AttributedString* createAttributedStringFromInputStream (InputStream& stream, LoadProgress* progress = nullptr,
+                                                                    LoadLimits* limits = nullptr);
+    static void writeAttributedStringToOutputStream (const AttributedString& str, OutputStream& stream, bool compress = false);
+
+    static AttributedString* createAttributedStringFromFile (const File& inputFile, LoadProgress* progress = nullptr,
+                                                             LoadLimits* limits = nullptr);
+    static void writeAttributedStringToFile (const AttributedString& str, const File& outFile, bool compress = false);
+
+    /** The binary format (see AttributedStringBinaryFormat) is much quicker to
+        load than the XML. A file is memory-mapped and the text of each run is
+        appended straight from the mapping, without being decoded. With a
+        paragraph index, any part of it can be loaded on its own: see
+        createAttributedStringFromFileRange().
+    */
+    static AttributedString* createAttributedStringFromBinary (const void* data, size_t numBytes, LoadLimits* limits = nullptr);
+    static void writeAttributedStringToBinary (const AttributedString& str, OutputStream& stream, bool includeParagraphIndex = false);
+
+    static AttributedString* createAttributedStringFromBinaryFile (const File& binaryFile, LoadLimits* limits = nullptr);
+    static void writeAttributedStringToBinaryFile (const AttributedString& str, const File& outFile, bool includeParagraphIndex = false);
+
+    /** Loads only the given paragraphs of an XML, binary or RTF file, i.e. the
+        text between the newlines before them and their own last newline.
+
+        A binary file with a paragraph index is memory-mapped and only the text
+        and runs of the paragraphs are read, however large the file is. Any
+        other file has to be loaded completely first.
+    */
+    static AttributedString* createAttributedStringFromFileRange (const File& file, int firstParagraph, int numParagraphs);
+
+    /** The pictures, objects and themes which an AttributedString can't hold are
+        skipped, unless there's an EmbeddedDataHandler to hand them to, e.g. an
+        EmbeddedDataFileWriter which writes them to files next to the document.
+    */
+    static AttributedString* createAttributedStringFromRTFData (InputStream& stream, LoadProgress* progress = nullptr,
+                                                               LoadLimits* limits = nullptr,
+                                                               EmbeddedDataHandler* embeddedData = nullptr);
+    static AttributedString* createAttributedStringFromRTFFile (const File& rtfFile, LoadProgress* progress = nullptr,
+                                                               LoadLimits* limits = nullptr,
+                                                               EmbeddedDataHandler* embeddedData = nullptr);
+
+    /** Parses the RTF on several threads: see RtfParser::parseInParallel(). A file
+        is memory-mapped, as with the binary format.
+    */
+    static AttributedString* createAttributedStringFromRTFDataInParallel (const void* data, size_t numBytes, int numThreads);
+    static AttributedString* createAttributedStringFromRTFFileInParallel (const File& rtfFile, int numThreads);
+
+    /** Merges neighbouring attributes which have the same font and colour.
+
+        The loaders above already do this while they read, so this is only needed
+        for strings which have been built up some other way.
+    */
+    struct CoalesceResult
+    {
+        int numAttributesBefore = 0, numAttributesAfter = 0;
+    };
+
+    static CoalesceResult coalesceRuns (AttributedString& str);
+
+    /** Loads an XML, binary or RTF file straight into an AttributedRunTable, for
+        callers which look up the formatting of characters rather than draw the
+        whole string. The AttributedString it's converted from is freed before
+        this returns.
+    */
+    static AttributedRunTable* createRunTableFromFile (const File& file, LoadProgress* progress = nullptr,
+                                                       LoadLimits* limits = nullptr);
+
+    //==============================================================================
+    /** These load into an existing AttributedString or AttributedRunTable instead
+        of creating a new one, replacing what it held, and return false where the
+        create functions return nullptr, leaving it empty.
+
+        A thread which loads many documents can keep one string or table, and one
+        ParseArena for the buffers which the loaders use while they parse, and
+        pass them to every load, so that steady-state loading hardly touches the
+        heap beyond the text and runs of the result. An AttributedRunTable keeps
+        the capacity of its arrays from one load to the next.
+
+        e.g.
+        @code
+        ParseArena arena;
+        AttributedString document;
+
+        for (auto& file : files)
+            if (AttributedStringSerializer::loadAttributedStringFromRTFFile (file, document, nullptr, nullptr, nullptr, &arena))
+                convert (document);
+        @endcode
+    */
+    static bool loadAttributedStringFromInputStream (InputStream& stream, AttributedString& result, LoadProgress* progress = nullptr,
+                                                     LoadLimits* limits = nullptr, ParseArena* arena = nullptr);
+    static bool loadAttributedStringFromFile (const File& inputFile, AttributedString& result, LoadProgress* progress = nullptr,
+                                              LoadLimits* limits = nullptr, ParseArena* arena = nullptr);
+
+    static bool loadAttributedStringFromBinary (const void* data, size_t numBytes, AttributedString& result, LoadLimits* limits = nullptr);
+    static bool loadAttributedStringFromBinaryFile (const File& binaryFile, AttributedString& result, LoadLimits* limits = nullptr);
+
+    static bool loadAttributedStringFromRTFData (InputStream& stream, AttributedString& result, LoadProgress* progress = nullptr,
+                                                 LoadLimits* limits = nullptr, EmbeddedDataHandler* embeddedData = nullptr,
+                                                 ParseArena* arena = nullptr);
+    static bool loadAttributedStringFromRTFFile (const File& rtfFile, AttributedString& result, LoadProgress* progress = nullptr,
+                                                 LoadLimits* limits = nullptr, EmbeddedDataHandler* embeddedData = nullptr,
+                                                 ParseArena* arena = nullptr);
 
-    static AttributedString* createAttributedStringFromFile (const File& inputFile);
-    static void writeAttributedStringToFile (const AttributedString& str, const File& outFile);
+    static bool loadRunTableFromFile (const File& file, AttributedRunTable& result, LoadProgress* progress = nullptr,
+                                      LoadLimits* limits = nullptr, ParseArena* arena = nullptr);
 
    #if (JUCE_MAC || JUCE_IOS)
-    static AttributedString* createAttributedStringFromRTFData (InputStream& stream);
-    static AttributedString* createAttributedStringFromRTFFile (const File& rtfFile);
+    static AttributedString* createAttributedStringFromRTFDataUsingCocoa (InputStream& stream);
    #endif
 };
@@ -0,0 +1,167 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "AttributedStringTextWriter.h"
+#include "SerializerStats.h"
+
+namespace
+{
+    // the writers collect their output and hand it on in blocks of about this size
+    const size_t blockSize = 65536;
+
+    void writeBlock (OutputStream& out, MemoryOutputStream& buffer)
+    {
+        if (buffer.getDataSize() > 0)
+        {
+            ATTRIBUTED_STRING_STATS_PHASE (writingOutput);
+            ATTRIBUTED_STRING_STATS_ADD (numBytesWritten, (int64) buffer.getDataSize());
+            out.write (buffer.getData(), buffer.getDataSize());
+        }
+
+        buffer.reset();
+    }
+}
+
+//==============================================================================
+void AttributedStringTextWriter::writePlainText (const AttributedString& attributedString, OutputStream& stream)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
+
+    const String& text = attributedString.getText();
+
+    ATTRIBUTED_STRING_STATS_PHASE (writingOutput);
+    ATTRIBUTED_STRING_STATS_ADD (numBytesWritten, (int64) text.getNumBytesAsUTF8());
+    stream.write (text.toRawUTF8(), text.getNumBytesAsUTF8());
+}
+
+void AttributedStringTextWriter::writeHtml (const AttributedString& attributedString, OutputStream& stream)
+{
+    ATTRIBUTED_STRING_STATS_CALL();
+
+    HtmlRunWriter writer (stream);
+    AttributedRunWriter::writeAll (attributedString, writer);
+    writer.finish();
+}
+
+//==============================================================================
+AttributedStringTextWriter::PlainTextRunWriter::PlainTextRunWriter (OutputStream& stream)
+    : out (stream), buffer (blockSize + 4096)
+{
+}
+
+void AttributedStringTextWriter::PlainTextRunWriter::writeRun (const char* utf8, size_t numBytes, const Font&, Colour)
+{
+    buffer.write (utf8, numBytes);
+
+    if (buffer.getDataSize() >= blockSize)
+        writeBlock (out, buffer);
+}
+
+void AttributedStringTextWriter::PlainTextRunWriter::finish()
+{
+    writeBlock (out, buffer);
+}
+
+//==============================================================================
+AttributedStringTextWriter::HtmlRunWriter::HtmlRunWriter (OutputStream& stream)
+    : out (stream), buffer (blockSize + 4096)
+{
+}
+
+void AttributedStringTextWriter::HtmlRunWriter::writeRun (const char* utf8, size_t numBytes, const Font& font, Colour colour)
+{
+    if (! hasStarted)
+    {
+        buffer << "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n</head>\n"
+                  "<body style=\"white-space: pre-wrap\">";
+        hasStarted = true;
+    }
+
+    if (numBytes == 0)
+        return;
+
+    buffer << "<span style=\"";
+    writeStyle (font, colour);
+    buffer << "\">";
+    writeEscaped (utf8, utf8 + numBytes, false);
+    buffer << "</span>";
+
+    flushIfFull();
+}
+
+void AttributedStringTextWriter::HtmlRunWriter::finish()
+{
+    if (! hasStarted)
+        writeRun (nullptr, 0, Font(), Colour());
+
+    buffer << "</body>\n</html>\n";
+    writeBlock (out, buffer);
+}
+
+void AttributedStringTextWriter::HtmlRunWriter::writeStyle (const Font& font, Colour colour)
+{
+    // the family is a CSS string in single quotes, inside an attribute in double quotes
+    const String family (font.getTypefaceName().replace ("\\", "\\\\").replace ("'", "\\'"));
+
+    buffer << "font-family: '";
+    writeEscaped (family.toRawUTF8(), family.toRawUTF8() + family.getNumBytesAsUTF8(), true);
+
+    char number[32];
+    snprintf (number, sizeof (number), "%.4g", static_cast<double> (font.getHeight()));
+    buffer << "'; font-size: " << number << "px";
+
+    if (font.isBold())          buffer << "; font-weight: bold";
+    if (font.isItalic())        buffer << "; font-style: italic";
+    if (font.isUnderlined())    buffer << "; text-decoration: underline";
+
+    if (colour.getAlpha() == 0xff)
+    {
+        buffer << "; color: #" << colour.toDisplayString (false).toLowerCase();
+    }
+    else
+    {
+        snprintf (number, sizeof (number), "%.3g", static_cast<double> (colour.getFloatAlpha()));
+
+        buffer << "; color: rgba(" << (int) colour.getRed() << ", " << (int) colour.getGreen() << ", "
+               << (int) colour.getBlue() << ", " << number << ")";
+    }
+}
+
+void AttributedStringTextWriter::HtmlRunWriter::writeEscaped (const char* text, const char* end, bool isAttribute)
+{
+    const char* plainStart = text;
+
+    for (; text < end; ++text)
+    {
+        const char* entity;
+
+        switch (*text)
+        {
+            case '&':   entity = "&amp;";  break;
+            case '<':   entity = "&lt;";   break;
+            case '>':   entity = "&gt;";   break;
+            case '"':   if (isAttribute) { entity = "&quot;"; break; } continue;
+            default:    continue;
+        }
+
+        buffer.write (plainStart, (size_t) (text - plainStart));
+        buffer << entity;
+        plainStart = text + 1;
+
+        flushIfFull();
+    }
+
+    buffer.write (plainStart, (size_t) (text - plainStart));
+}
+
+void AttributedStringTextWriter::HtmlRunWriter::flushIfFull()
+{
+    if (buffer.getDataSize() >= blockSize)
+        writeBlock (out, buffer);
+}
@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "AttributedRunWriter.h"
+
+//==============================================================================
+/**
+    Writes an AttributedString for search indexing and the web, rather than to
+    be loaded again: as plain UTF-8 text, or as an HTML page with a <span> for
+    each run which carries its font and colour as inline CSS.
+
+    Newlines are kept as they are: the HTML body is styled with
+    "white-space: pre-wrap", so they still break the lines.
+*/
+struct AttributedStringTextWriter
+{
+    static void writePlainText (const AttributedString& attributedString, OutputStream& stream);
+    static void writeHtml (const AttributedString& attributedString, OutputStream& stream);
+
+    //==============================================================================
+    class PlainTextRunWriter  : public AttributedRunWriter
+    {
+    public:
+        PlainTextRunWriter (OutputStream& stream);
+
+        void writeRun (const char* utf8, size_t numBytes, const Font& font, Colour colour) override;
+        void finish() override;
+
+    private:
+        OutputStream& out;
+        MemoryOutputStream buffer;
+
+        JUCE_DECLARE_NON_COPYABLE (PlainTextRunWriter)
+    };
+
+    //==============================================================================
+    class HtmlRunWriter  : public AttributedRunWriter
+    {
+    public:
+        HtmlRunWriter (OutputStream& stream);
+
+        void writeRun (const char* utf8, size_t numBytes, const Font& font, Colour colour) override;
+        void finish() override;
+
+    private:
+        void writeStyle (const Font& font, Colour colour);
+        void writeEscaped (const char* text, const char* end, bool isAttribute);
+        void flushIfFull();
+
+        OutputStream& out;
+        MemoryOutputStream buffer;
+        bool hasStarted = false;
+
+        JUCE_DECLARE_NON_COPYABLE (HtmlRunWriter)
+    };
+};
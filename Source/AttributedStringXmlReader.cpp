@@ -0,0 +1,800 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "AttributedStringXmlReader.h"
+#include "AttributedStringBuilder.h"
+#include "StreamByteReader.h"
+#include "Utf8Buffer.h"
+#include "FontCache.h"
+#include "LoadProgress.h"
+#include "LoadLimits.h"
+
+namespace
+{
+    static bool isXmlWhitespace (int c) noexcept
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    static bool isNameCharacter (int c) noexcept
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+                || c == '_' || c == '-' || c == ':' || c == '.' || c >= 0x80;
+    }
+
+    static bool matchesBytes (const String& s, const Utf8Buffer& bytes) noexcept
+    {
+        return s.getNumBytesAsUTF8() == bytes.getSize()
+                && (bytes.isEmpty() || memcmp (s.toRawUTF8(), bytes.getData(), bytes.getSize()) == 0);
+    }
+
+    // The same as checking the tokens of StringArray::fromTokens (value, ",", "")
+    static int parseStyleFlags (const char* p, const char* end) noexcept
+    {
+        int styleFlags = 0;
+
+        for (;;)
+        {
+            const char* tokenEnd = p;
+
+            while (tokenEnd < end && *tokenEnd != ',')
+                ++tokenEnd;
+
+            const size_t length = (size_t) (tokenEnd - p);
+
+            if      (length == 4  && memcmp (p, "bold", 4) == 0)          styleFlags |= Font::bold;
+            else if (length == 6  && memcmp (p, "italic", 6) == 0)        styleFlags |= Font::italic;
+            else if (length == 10 && memcmp (p, "underlined", 10) == 0)   styleFlags |= Font::underlined;
+
+            if (tokenEnd == end)
+                return styleFlags;
+
+            p = tokenEnd + 1;
+        }
+    }
+
+    // The same as taking the three two-character substrings after the '#' of a
+    // seven-character value and calling getHexValue32() on each of them, which
+    // skips anything that isn't a hex digit
+    static Colour parseColour (const char* p, const char* end) noexcept
+    {
+        if (p == end || *p != '#')
+            return Colours::transparentBlack;
+
+        uint8 components[3] = {};
+        int numChars = 0;
+
+        for (; p < end; ++p)
+        {
+            if ((*p & 0xc0) == 0x80)
+                continue;   // a UTF-8 continuation byte
+
+            const int digit = CharacterFunctions::getHexDigitValue ((juce_wchar) (uint8) *p);
+
+            if (numChars > 0 && numChars <= 6 && digit >= 0)
+            {
+                uint8& c = components[(numChars - 1) / 2];
+                c = (uint8) ((c << 4) | digit);
+            }
+
+            ++numChars;
+        }
+
+        return numChars == 7 ? Colour (components[0], components[1], components[2])
+                             : Colours::transparentBlack;
+    }
+
+    //==============================================================================
+    /** Element and attribute names are only ever compared against a handful of
+        short ASCII names, so they are kept in a fixed buffer. Longer names are
+        truncated and then can't match anything.
+    */
+    struct XmlName
+    {
+        enum { maxLength = 15 };
+
+        void clear() noexcept                           { length = 0; tooLong = false; }
+
+        void add (int c) noexcept
+        {
+            if (length < (int) maxLength)   chars[length++] = (char) c;
+            else                            tooLong = true;
+        }
+
+        bool operator== (const char* other) const noexcept
+        {
+            return ! tooLong && (int) strlen (other) == length && memcmp (chars, other, (size_t) length) == 0;
+        }
+
+        char chars[maxLength];
+        int length = 0;
+        bool tooLong = false;
+    };
+
+    //==============================================================================
+    class XmlReader  : private StreamByteReader::Listener
+    {
+    public:
+        XmlReader (InputStream& in, AttributedString& resultToFill, LoadProgress* progressToUse, LoadLimits* limitsToUse,
+                   ParseArena* arena)
+            : reader (in, 65536, arena), result (resultToFill), builder (result, arena), progress (progressToUse), limits (limitsToUse),
+              attributeValue (arena), textNode (arena)
+        {
+            if (progress != nullptr || limits != nullptr)
+                reader.setListener (this);
+
+            if (progress != nullptr)
+                builder.setRunWriter (progress->getRunWriter());
+        }
+
+        bool wasCancelled() const noexcept      { return reader.wasStopped(); }
+
+        bool parse()
+        {
+            if (! readProlog())
+                return false;
+
+            bool selfClosing;
+
+            if (! readStartTag (next(), selfClosing))
+                return false;
+
+            if (! selfClosing && ! readContent())
+                return false;
+
+            builder.flush();
+            return true;
+        }
+
+    private:
+        bool aboutToReadChunk (int64 numBytesConsumed) override
+        {
+            if (limits != nullptr && ! limits->checkProgress (numBytesConsumed, builder))
+                return false;
+
+            return progress == nullptr || progress->update (numBytesConsumed, builder);
+        }
+
+        //==============================================================================
+        // XmlDocument gets its text from InputStream::readString(), which stops at a null
+        int next()
+        {
+            const int c = reader.next();
+            return c > 0 ? c : -1;
+        }
+
+        int skipWhitespace()
+        {
+            int c;
+
+            do { c = next(); } while (isXmlWhitespace (c));
+
+            return c;
+        }
+
+        bool skipPast (const char* terminator)
+        {
+            const size_t len = strlen (terminator);
+            jassert (len <= 3);
+
+            char lastChars[3] = { 0, 0, 0 };
+
+            for (;;)
+            {
+                const int c = next();
+
+                if (c < 0)
+                    return false;
+
+                lastChars[0] = lastChars[1];
+                lastChars[1] = lastChars[2];
+                lastChars[2] = (char) c;
+
+                if (memcmp (lastChars + 3 - len, terminator, len) == 0)
+                    return true;
+            }
+        }
+
+        bool expect (const char* chars)
+        {
+            for (; *chars != 0; ++chars)
+                if (next() != (uint8) *chars)
+                    return false;
+
+            return true;
+        }
+
+        //==============================================================================
+        bool readProlog()
+        {
+            int c = next();
+
+            // UTF-8 byte order mark
+            if (c == 0xef)
+            {
+                if (next() != 0xbb || next() != 0xbf)
+                    return false;
+
+                c = next();
+            }
+
+            for (;;)
+            {
+                while (isXmlWhitespace (c))
+                    c = next();
+
+                if (c != '<')
+                    return false;
+
+                c = next();
+
+                if (c == '?')
+                {
+                    if (! skipPast ("?>"))
+                        return false;
+                }
+                else if (c == '!')
+                {
+                    if (! skipDeclarationOrComment())
+                        return false;
+                }
+                else
+                {
+                    reader.pushBack();
+                    return true;
+                }
+
+                c = next();
+            }
+        }
+
+        // called after "<!"
+        bool skipDeclarationOrComment()
+        {
+            int c = next();
+
+            if (c == '-')
+                return next() == '-' && skipPast ("-->");
+
+            // a DOCTYPE, possibly with an internal subset in square brackets
+            int bracketDepth = 0;
+
+            for (;; c = next())
+            {
+                if (c < 0)                                  return false;
+                if (c == '[')                               ++bracketDepth;
+                else if (c == ']')                          --bracketDepth;
+                else if (c == '>' && bracketDepth <= 0)     return true;
+            }
+        }
+
+        //==============================================================================
+        bool readContent()
+        {
+            int depth = 1;
+
+            for (;;)
+            {
+                int c = next();
+
+                if (c < 0)
+                    return false;
+
+                if (c != '<')
+                {
+                    if (! readText (c))
+                        return false;
+
+                    continue;
+                }
+
+                c = next();
+
+                if (c == '!')
+                {
+                    c = next();
+
+                    if (c == '[')
+                    {
+                        // CDATA belongs to the surrounding text node
+                        if (! expect ("CDATA[") || ! readCData())
+                            return false;
+
+                        continue;
+                    }
+
+                    flushTextNode (depth);
+
+                    if (c == '-' ? ! (next() == '-' && skipPast ("-->"))
+                                 : ! skipPast (">"))
+                        return false;
+
+                    continue;
+                }
+
+                flushTextNode (depth);
+
+                if (c == '?')
+                {
+                    if (! skipPast ("?>"))
+                        return false;
+                }
+                else if (c == '/')
+                {
+                    // like XmlDocument, the name of the closing tag isn't checked
+                    if (! skipPast (">"))
+                        return false;
+
+                    if (depth == 2)
+                        inFont = false;
+
+                    if (--depth == 0)
+                        return true;
+                }
+                else
+                {
+                    bool selfClosing;
+
+                    if (! readStartTag (c, selfClosing))
+                        return false;
+
+                    handleElement (depth, selfClosing);
+
+                    if (! selfClosing)
+                    {
+                        if (limits != nullptr && ! limits->checkDepth (depth))
+                        {
+                            reader.stop();
+                            return false;
+                        }
+
+                        ++depth;
+                    }
+                }
+            }
+        }
+
+        void handleElement (int depth, bool selfClosing)
+        {
+            if (depth == 1)
+            {
+                if (tagName == "br")
+                {
+                    appendText ("\n", 1, nullptr, nullptr);
+                }
+                else if (tagName == "font" && ! selfClosing)
+                {
+                    beginFont();
+                    inFont = true;
+                }
+            }
+            else if (depth == 2 && inFont && tagName == "br")
+            {
+                appendToFont ("\n", 1);
+            }
+        }
+
+        //==============================================================================
+        bool readStartTag (int c, bool& selfClosing)
+        {
+            if (! isNameCharacter (c))
+                return false;
+
+            tagName.clear();
+
+            do
+            {
+                tagName.add (c);
+                c = next();
+            }
+            while (isNameCharacter (c));
+
+            const bool isFont = (tagName == "font");
+
+            if (isFont)
+                hasSize = hasFamily = hasStyle = hasColour = false;
+
+            for (;;)
+            {
+                while (isXmlWhitespace (c))
+                    c = next();
+
+                if (c == '>')
+                {
+                    selfClosing = false;
+                    return true;
+                }
+
+                if (c == '/')
+                {
+                    selfClosing = true;
+                    return next() == '>';
+                }
+
+                if (! isNameCharacter (c))
+                    return false;
+
+                attributeName.clear();
+
+                do
+                {
+                    attributeName.add (c);
+                    c = next();
+                }
+                while (isNameCharacter (c));
+
+                while (isXmlWhitespace (c))
+                    c = next();
+
+                if (c != '=')
+                    return false;
+
+                c = skipWhitespace();
+
+                if (c != '"' && c != '\'')
+                    return false;
+
+                if (! readAttributeValue (c))
+                    return false;
+
+                if (isFont)
+                    storeFontAttribute();
+
+                c = next();
+            }
+        }
+
+        bool readAttributeValue (int quote)
+        {
+            attributeValue.clear();
+            bool hasNonWhitespace = false;
+
+            for (;;)
+            {
+                const int c = next();
+
+                if (c < 0)
+                    return false;
+
+                if (c == quote)
+                    return true;
+
+                if (c == '&')
+                {
+                    if (! readEntity (attributeValue, hasNonWhitespace))
+                        return false;
+                }
+                else
+                {
+                    attributeValue.appendByte ((char) c);
+                }
+            }
+        }
+
+        void storeFontAttribute()
+        {
+            // if an attribute is repeated, XmlElement returns the first one. The values are
+            // parsed straight from the buffer, so only a family that changes needs a String
+            const char* const value = attributeValue.getData();
+            const char* const valueEnd = value + attributeValue.getSize();
+
+            if (attributeName == "style" && ! hasStyle)
+            {
+                styleValue = parseStyleFlags (value, valueEnd);
+                hasStyle = true;
+            }
+            else if (attributeName == "colour" && ! hasColour)
+            {
+                colourValue = parseColour (value, valueEnd);
+                hasColour = true;
+            }
+            else if (attributeName == "family" && ! hasFamily)
+            {
+                if (! matchesBytes (familyValue, attributeValue))
+                    familyValue = attributeValue.toString();
+
+                hasFamily = true;
+            }
+            else if (attributeName == "size" && ! hasSize)
+            {
+                attributeValue.appendByte (0);
+                sizeValue = CharacterFunctions::getDoubleValue (CharPointer_UTF8 (attributeValue.getData()));
+                hasSize = true;
+            }
+        }
+
+        //==============================================================================
+        bool readText (int c)
+        {
+            for (;;)
+            {
+                if (c == '&')
+                {
+                    if (! readEntity (textNode, textNodeIsUsed))
+                        return false;
+                }
+                else if (c == '\r')
+                {
+                    textNode.appendByte ('\n');
+
+                    const int following = next();
+
+                    if (following >= 0 && following != '\n')
+                        reader.pushBack();
+                }
+                else
+                {
+                    textNode.appendByte ((char) c);
+                    textNodeIsUsed = textNodeIsUsed || ! isXmlWhitespace (c);
+
+                    // copy the rest of a span without markup straight out of the read buffer
+                    const char* const data = reader.getBufferedData();
+                    const int available = reader.getNumBufferedBytes();
+                    int num = 0;
+
+                    while (num < available)
+                    {
+                        const char b = data[num];
+
+                        if (b == '<' || b == '&' || b == '\r' || b == 0)
+                            break;
+
+                        textNodeIsUsed = textNodeIsUsed || ! isXmlWhitespace ((uint8) b);
+                        ++num;
+                    }
+
+                    textNode.append (data, (size_t) num);
+                    reader.skipBufferedBytes (num);
+                }
+
+                c = next();
+
+                if (c < 0)
+                    return false;
+
+                if (c == '<')
+                {
+                    reader.pushBack();
+                    return true;
+                }
+            }
+        }
+
+        // called after "<![CDATA["
+        bool readCData()
+        {
+            int numBrackets = 0;
+
+            for (;;)
+            {
+                const int c = next();
+
+                if (c < 0)
+                    return false;
+
+                if (c == ']')
+                {
+                    ++numBrackets;
+                    continue;
+                }
+
+                if (c == '>' && numBrackets >= 2)
+                {
+                    for (int i = 2; i < numBrackets; ++i)
+                        textNode.appendByte (']');
+
+                    return true;
+                }
+
+                for (; numBrackets > 0; --numBrackets)
+                    textNode.appendByte (']');
+
+                textNode.appendByte ((char) c);
+                textNodeIsUsed = true;
+            }
+        }
+
+        // called after '&'
+        bool readEntity (Utf8Buffer& target, bool& hasNonWhitespace)
+        {
+            XmlName name;
+            int c;
+
+            for (;;)
+            {
+                c = next();
+
+                if (c == ';')
+                    break;
+
+                if (c < 0 || c == '<' || c == '&' || isXmlWhitespace (c) || name.length == (int) XmlName::maxLength)
+                {
+                    // not an entity after all: keep the text as it was
+                    target.appendByte ('&');
+                    target.append (name.chars, (size_t) name.length);
+                    hasNonWhitespace = true;
+
+                    if (c >= 0)
+                        reader.pushBack();
+
+                    return true;
+                }
+
+                name.add (c);
+            }
+
+            juce_wchar decoded = 0;
+
+            if (name.length > 0 && name.chars[0] == '#')
+            {
+                if (! parseCharacterReference (name, decoded))
+                    return false;
+            }
+            else
+            {
+                String entity (name.chars, (size_t) name.length);
+
+                if      (entity.equalsIgnoreCase ("amp"))   decoded = '&';
+                else if (entity.equalsIgnoreCase ("quot"))  decoded = '"';
+                else if (entity.equalsIgnoreCase ("apos"))  decoded = '\'';
+                else if (entity.equalsIgnoreCase ("lt"))    decoded = '<';
+                else if (entity.equalsIgnoreCase ("gt"))    decoded = '>';
+            }
+
+            if (decoded == 0)
+            {
+                // an entity we don't know about
+                target.appendByte ('&');
+                target.append (name.chars, (size_t) name.length);
+                target.appendByte (';');
+                hasNonWhitespace = true;
+                return true;
+            }
+
+            target.appendCharacter (decoded);
+            hasNonWhitespace = hasNonWhitespace || ! isXmlWhitespace ((int) decoded);
+            return true;
+        }
+
+        static bool parseCharacterReference (const XmlName& name, juce_wchar& result) noexcept
+        {
+            const bool isHex = (name.length > 1 && (name.chars[1] == 'x' || name.chars[1] == 'X'));
+            const int start = isHex ? 2 : 1;
+
+            if (start >= name.length)
+                return false;
+
+            uint32 value = 0;
+
+            for (int i = start; i < name.length; ++i)
+            {
+                const char c = name.chars[i];
+                int digit;
+
+                if (c >= '0' && c <= '9')                   digit = c - '0';
+                else if (isHex && c >= 'a' && c <= 'f')     digit = c - 'a' + 10;
+                else if (isHex && c >= 'A' && c <= 'F')     digit = c - 'A' + 10;
+                else                                        return false;
+
+                value = value * (isHex ? 16u : 10u) + (uint32) digit;
+
+                if (value > 0x10ffff)
+                    return false;
+            }
+
+            result = (juce_wchar) value;
+            return value != 0;
+        }
+
+        //==============================================================================
+        void flushTextNode (int depth)
+        {
+            if (textNodeIsUsed)
+            {
+                if (depth == 1)
+                    appendText (textNode.getData(), textNode.getSize(), nullptr, nullptr);
+                else if (depth == 2 && inFont)
+                    appendToFont (textNode.getData(), textNode.getSize());
+            }
+
+            textNode.clear();
+            textNodeIsUsed = false;
+        }
+
+        void beginFont()
+        {
+            colour = hasColour ? colourValue : Colours::transparentBlack;
+            family = hasFamily ? familyValue : String();
+
+            if (family.isNotEmpty())
+                font = FontCache::getInstance()->getFont (family, hasSize ? static_cast<float> (sizeValue) : 12.0f,
+                                                          hasStyle ? styleValue : 0, &lastFont);
+        }
+
+        // All the text of a <font> element ends up in the builder's pending run, so
+        // it only becomes an attribute once, when the formatting next changes
+        void appendToFont (const char* text, size_t numBytes)
+        {
+            appendText (text, numBytes,
+                        family.isNotEmpty()     ? &font   : nullptr,
+                        colour.getAlpha() != 0  ? &colour : nullptr);
+        }
+
+        void appendText (const char* text, size_t numBytes, const Font* runFont, const Colour* runColour)
+        {
+            builder.append (text, numBytes, runFont, runColour);
+
+            if (limits != nullptr && ! limits->checkRun (builder))
+                reader.stop();
+        }
+
+        //==============================================================================
+        StreamByteReader reader;
+        AttributedString& result;
+        AttributedStringBuilder builder;
+        LoadProgress* const progress;
+        LoadLimits* const limits;
+
+        XmlName tagName, attributeName;
+        Utf8Buffer attributeValue, textNode;
+        bool textNodeIsUsed = false;
+
+        String familyValue;
+        double sizeValue = 0;
+        int styleValue = 0;
+        Colour colourValue;
+        bool hasSize = false, hasFamily = false, hasStyle = false, hasColour = false;
+
+        bool inFont = false;
+        String family;
+        Font font;
+        FontCache::LastFont lastFont;
+        Colour colour;
+
+        JUCE_DECLARE_NON_COPYABLE (XmlReader)
+    };
+}
+
+//==============================================================================
+AttributedString* AttributedStringXmlReader::parse (InputStream& stream, LoadProgress* progress, LoadLimits* limits)
+{
+    ScopedPointer<AttributedString> result (new AttributedString);
+    return parse (stream, *result, progress, limits) ? result.release() : nullptr;
+}
+
+bool AttributedStringXmlReader::parse (InputStream& stream, AttributedString& result, LoadProgress* progress,
+                                       LoadLimits* limits, ParseArena* arena)
+{
+    AttributedStringBuilder::resetTarget (result);
+
+    if (arena != nullptr)
+        arena->reset();
+
+    if (limits != nullptr)
+    {
+        limits->loadStarted();
+
+        const int64 totalLength = stream.getTotalLength();
+
+        if (totalLength >= 0 && ! limits->checkInputSize (totalLength - stream.getPosition()))
+            return false;
+    }
+
+    bool ok;
+
+    {
+        XmlReader reader (stream, result, progress, limits, arena);
+        ok = reader.parse() && ! reader.wasCancelled();
+    }
+
+    if (! ok)
+        AttributedStringBuilder::resetTarget (result);
+
+    return ok;
+}
@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+class LoadProgress;
+class LoadLimits;
+class ParseArena;
+
+//==============================================================================
+/**
+    A pull parser for the XML format that AttributedStringSerializer writes.
+
+    The stream is read in fixed size chunks and the text is handed to an
+    AttributedStringBuilder as soon as it has been read, so neither a copy of the
+    whole document nor an XmlElement tree is ever built. All the text of a <font>
+    element (and of neighbouring elements with the same formatting) becomes a
+    single attribute. Otherwise the result is the same as loading the document
+    into an XmlDocument and walking its elements: whitespace-only text nodes are
+    dropped, line endings are normalised and any malformed XML makes the reader
+    return nullptr.
+
+    If a LoadProgress is given, it is told about each chunk before it is read
+    and can cancel the load. If LoadLimits are given, a document which exceeds
+    them makes the reader return nullptr too.
+*/
+struct AttributedStringXmlReader
+{
+    static AttributedString* parse (InputStream& stream, LoadProgress* progress = nullptr, LoadLimits* limits = nullptr);
+
+    /** Reads into an existing AttributedString, replacing what it held, and returns
+        false where the other version returns nullptr, leaving the string empty.
+        Buffers for the parse come from the arena, if there is one.
+    */
+    static bool parse (InputStream& stream, AttributedString& result, LoadProgress* progress = nullptr,
+                       LoadLimits* limits = nullptr, ParseArena* arena = nullptr);
+};
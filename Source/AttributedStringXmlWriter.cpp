@@ -0,0 +1,527 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "AttributedStringXmlWriter.h"
+#include "SerializerStats.h"
+
+#if ! defined (ATTRIBUTED_STRING_USE_SSE2) && (defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2))
+ #define ATTRIBUTED_STRING_USE_SSE2 1
+#endif
+
+#if ATTRIBUTED_STRING_USE_SSE2
+ #include <emmintrin.h>
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #endif
+#endif
+
+namespace
+{
+    // the same table XmlElement uses to decide which characters can be written as they are
+    const unsigned char legalXmlChars[] = { 0, 0, 0, 0, 187, 255, 255, 175, 255, 255, 255, 191, 254, 255, 255, 127 };
+
+    static bool isLegalXmlChar (uint32 c) noexcept
+    {
+        return c < sizeof (legalXmlChars) * 8
+                 && (legalXmlChars[c >> 3] & (1 << (c & 7))) != 0;
+    }
+
+   #if ATTRIBUTED_STRING_USE_SSE2
+    static int findLowestSetBit (uint32 mask) noexcept
+    {
+       #if JUCE_MSVC
+        unsigned long index;
+        _BitScanForward (&index, mask);
+        return (int) index;
+       #else
+        return __builtin_ctz (mask);
+       #endif
+    }
+   #endif
+
+    // Returns the first byte in [p, end) that can't be written as it is, or end.
+    // Every legal byte is printable ASCII, so this also counts characters.
+    static const char* findFirstIllegalXmlChar (const char* p, const char* end) noexcept
+    {
+       #if ATTRIBUTED_STRING_USE_SSE2
+        // the bytes the table rejects: controls, DEL, anything non-ASCII and " & < > ^ `
+        // (a signed compare with ' ' catches both the controls and the bytes >= 0x80)
+        const __m128i space     = _mm_set1_epi8 (' ');
+        const __m128i del       = _mm_set1_epi8 (127);
+        const __m128i quote     = _mm_set1_epi8 ('"');
+        const __m128i ampersand = _mm_set1_epi8 ('&');
+        const __m128i lessThan  = _mm_set1_epi8 ('<');
+        const __m128i greater   = _mm_set1_epi8 ('>');
+        const __m128i caret     = _mm_set1_epi8 ('^');
+        const __m128i backtick  = _mm_set1_epi8 ('`');
+
+        while (end - p >= 16)
+        {
+            const __m128i v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (p));
+
+            const __m128i illegal = _mm_or_si128 (_mm_or_si128 (_mm_or_si128 (_mm_cmplt_epi8 (v, space),     _mm_cmpeq_epi8 (v, del)),
+                                                                 _mm_or_si128 (_mm_cmpeq_epi8 (v, quote),     _mm_cmpeq_epi8 (v, ampersand))),
+                                                  _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, lessThan),  _mm_cmpeq_epi8 (v, greater)),
+                                                                 _mm_or_si128 (_mm_cmpeq_epi8 (v, caret),     _mm_cmpeq_epi8 (v, backtick))));
+
+            if (const int mask = _mm_movemask_epi8 (illegal))
+                return p + findLowestSetBit ((uint32) mask);
+
+            p += 16;
+        }
+       #endif
+
+        while (p < end && isLegalXmlChar ((uint8) *p))
+            ++p;
+
+        return p;
+    }
+
+    // XmlElement::writeToStream's default
+    const int lineWrapLength = 60;
+
+    //==============================================================================
+    class XmlWriter
+    {
+    public:
+        XmlWriter (OutputStream& o)
+            : out (o), newLine (o.getNewLineString()), buffer ((size_t) bufferSize)
+        {
+        }
+
+        ~XmlWriter()
+        {
+            flushBuffer();
+        }
+
+        void write (const AttributedString& attrStr)
+        {
+            writeDeclaration();
+
+            const int n = attrStr.getNumAttributes();
+
+            if (n == 0)
+            {
+                writeRaw ("<JUCE/>");
+                writeNewLine();
+                return;
+            }
+
+            writeRaw ("<JUCE>");
+
+            TextCursor cursor (attrStr.getText());
+            bool lastWasTextNode = false;
+            int pos = 0;
+
+            for (int i = 0; i < n; ++i)
+            {
+                const AttributedString::Attribute& attr = attrStr.getAttribute (i);
+
+                if (pos < attr.range.getStart())
+                {
+                    const char* const gapStart = cursor.seek (pos);
+                    writeTextChildren (gapStart, cursor.seek (attr.range.getStart()), 0, lastWasTextNode);
+                    pos = attr.range.getStart();
+                }
+
+                if (! lastWasTextNode)
+                    writeNewLine();
+
+                const char* const textStart = cursor.seek (attr.range.getStart());
+                writeFont (attr.font, attr.colour, textStart, cursor.seek (attr.range.getEnd()),
+                           attr.range.isEmpty(), lastWasTextNode ? 0 : 2);
+                lastWasTextNode = false;
+
+                // this mirrors the original tree based writer, which never wrote
+                // the character following each attribute as a gap
+                pos = attr.range.getEnd() + 1;
+            }
+
+            writeNewLine();
+            writeRaw ("</JUCE>");
+            writeNewLine();
+        }
+
+        //==============================================================================
+        // Runs which follow each other without gaps come out just as write() would
+        // write the attributes they add up to.
+        void writeRun (const char* utf8, size_t numBytes, const Font& font, Colour colour)
+        {
+            if (numRunsWritten++ == 0)
+            {
+                writeDeclaration();
+                writeRaw ("<JUCE>");
+            }
+
+            writeNewLine();
+            writeFont (font, colour, utf8, utf8 + numBytes, numBytes == 0, 2);
+        }
+
+        void finishRuns()
+        {
+            if (numRunsWritten == 0)
+            {
+                writeDeclaration();
+                writeRaw ("<JUCE/>");
+                writeNewLine();
+            }
+            else
+            {
+                writeNewLine();
+                writeRaw ("</JUCE>");
+                writeNewLine();
+            }
+
+            flushBuffer();
+        }
+
+    private:
+        //==============================================================================
+        // Finds the characters of the text by index, moving on from the last one found
+        struct TextCursor
+        {
+            TextCursor (const String& t)  : text (t), position (t.getCharPointer())
+            {
+            }
+
+            const char* seek (int index)
+            {
+                if (index < positionIndex)
+                {
+                    position = text.getCharPointer();
+                    positionIndex = 0;
+                }
+
+                while (positionIndex < index && ! position.isEmpty())
+                {
+                    ++position;
+                    ++positionIndex;
+                }
+
+                return position.getAddress();
+            }
+
+            const String& text;
+            String::CharPointerType position;
+            int positionIndex = 0;
+        };
+
+        void writeDeclaration()
+        {
+            writeRaw ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>");
+            writeNewLine();
+            writeNewLine();
+        }
+
+        void writeFont (const Font& font, Colour colour, const char* text, const char* textEnd, bool isEmpty, int indent)
+        {
+            writeSpaces (indent);
+            writeRaw ("<font");
+
+            const int attributeIndent = indent + 5;
+            int lineLength = 0;
+
+            char buffer[32];
+            const int sizeLength = snprintf (buffer, sizeof (buffer), "%.20g", static_cast<double> (font.getHeight()));
+            writeAttribute ("size", buffer, (size_t) jlimit (0, (int) sizeof (buffer) - 1, sizeLength), attributeIndent, lineLength);
+
+            const String& family = font.getTypefaceName();
+            writeAttribute ("family", family.toRawUTF8(), family.getNumBytesAsUTF8(), attributeIndent, lineLength);
+
+            const int styleFlags = font.getStyleFlags();
+            size_t styleLength = 0;
+
+            if ((styleFlags & Font::bold)       != 0) appendStyle (buffer, styleLength, "bold");
+            if ((styleFlags & Font::italic)     != 0) appendStyle (buffer, styleLength, "italic");
+            if ((styleFlags & Font::underlined) != 0) appendStyle (buffer, styleLength, "underlined");
+
+            if (styleLength > 0)
+                writeAttribute ("style", buffer, styleLength, attributeIndent, lineLength);
+
+            static const char hexDigits[] = "0123456789abcdef";
+            const uint8 components[] = { colour.getRed(), colour.getGreen(), colour.getBlue() };
+
+            buffer[0] = '#';
+
+            for (int i = 0; i < 3; ++i)
+            {
+                buffer[1 + i * 2] = hexDigits[components[i] >> 4];
+                buffer[2 + i * 2] = hexDigits[components[i] & 15];
+            }
+
+            writeAttribute ("colour", buffer, 7, attributeIndent, lineLength);
+
+            if (isEmpty)
+            {
+                writeRaw ("/>");
+                return;
+            }
+
+            writeRaw (">");
+
+            bool lastWasTextNode = false;
+            writeTextChildren (text, textEnd, indent, lastWasTextNode);
+
+            if (! lastWasTextNode)
+            {
+                writeNewLine();
+                writeSpaces (indent);
+            }
+
+            writeRaw ("</font>");
+        }
+
+        static void appendStyle (char* buffer, size_t& length, const char* style) noexcept
+        {
+            if (length > 0)
+                buffer[length++] = ',';
+
+            const size_t num = strlen (style);
+            memcpy (buffer + length, style, num);
+            length += num;
+        }
+
+        void writeAttribute (const char* name, const char* value, size_t valueLength, int indent, int& lineLength)
+        {
+            if (lineLength > lineWrapLength)
+            {
+                writeNewLine();
+                writeSpaces (indent);
+                lineLength = 0;
+            }
+
+            const size_t nameLength = strlen (name);
+
+            put (' ');
+            put (name, nameLength);
+            put ("=\"", 2);
+            const size_t escapedLength = writeEscaped (value, value + valueLength);
+            put ('"');
+
+            lineLength += (int) (nameLength + escapedLength + 4);
+        }
+
+        //==============================================================================
+        // Writes the UTF-8 text [p, end) as the children of an element: text nodes,
+        // with a <br/> element for every newline
+        void writeTextChildren (const char* p, const char* end, int parentIndent, bool& lastWasTextNode)
+        {
+            while (p < end)
+            {
+                const char* const plainEnd = findFirstIllegalXmlChar (p, end);
+
+                if (plainEnd > p)
+                {
+                    put (p, (size_t) (plainEnd - p));
+                    p = plainEnd;
+                    lastWasTextNode = true;
+                    continue;
+                }
+
+                if (*p == '\n')
+                {
+                    if (! lastWasTextNode)
+                    {
+                        writeNewLine();
+                        writeSpaces (parentIndent + 2);
+                    }
+
+                    writeRaw ("<br/>");
+                    lastWasTextNode = false;
+
+                    ++p;
+                    continue;
+                }
+
+                CharPointer_UTF8 charPointer (p);
+                writeEscapedCharacter (charPointer.getAndAdvance(), false);
+                p = charPointer.getAddress();
+                lastWasTextNode = true;
+            }
+        }
+
+        // Writes an attribute value escaped the way XmlElement does it and returns the number of bytes written
+        size_t writeEscaped (const char* p, const char* end)
+        {
+            size_t numWritten = 0;
+
+            while (p < end)
+            {
+                const char* const legalEnd = findFirstIllegalXmlChar (p, end);
+
+                if (legalEnd > p)
+                {
+                    put (p, (size_t) (legalEnd - p));
+                    numWritten += (size_t) (legalEnd - p);
+                    p = legalEnd;
+                }
+
+                if (p >= end)
+                    break;
+
+                CharPointer_UTF8 charPointer (p);
+                numWritten += writeEscapedCharacter (charPointer.getAndAdvance(), true);
+                p = charPointer.getAddress();
+            }
+
+            return numWritten;
+        }
+
+        // Writes a character that findFirstIllegalXmlChar stopped at
+        size_t writeEscapedCharacter (juce_wchar c, bool changeNewLines)
+        {
+            switch (c)
+            {
+                case '&':   return writeRaw ("&amp;");
+                case '"':   return writeRaw ("&quot;");
+                case '>':   return writeRaw ("&gt;");
+                case '<':   return writeRaw ("&lt;");
+
+                case '\n':
+                case '\r':
+                    if (! changeNewLines)
+                    {
+                        put ((char) c);
+                        return 1;
+                    }
+                    // fall through
+
+                default:
+                    return writeCharacterReference (c);
+            }
+        }
+
+        size_t writeCharacterReference (juce_wchar c)
+        {
+            char buffer[16];
+            char* const end = buffer + sizeof (buffer);
+            char* p = end;
+
+            *--p = ';';
+
+            do
+            {
+                *--p = (char) ('0' + (c % 10));
+                c /= 10;
+            }
+            while (c != 0);
+
+            *--p = '#';
+            *--p = '&';
+
+            put (p, (size_t) (end - p));
+            return (size_t) (end - p);
+        }
+
+        //==============================================================================
+        size_t writeRaw (const char* s)
+        {
+            const size_t len = strlen (s);
+            put (s, len);
+            return len;
+        }
+
+        void writeNewLine()
+        {
+            put (newLine.toRawUTF8(), newLine.getNumBytesAsUTF8());
+        }
+
+        void writeSpaces (int num)
+        {
+            for (; num > 0; --num)
+                put (' ');
+        }
+
+        //==============================================================================
+        // Most writes are only a few bytes long, so they're collected here rather
+        // than each one going through the stream's virtual write()
+        void put (const char* data, size_t num)
+        {
+            if (bufferUsed + num > (size_t) bufferSize)
+            {
+                flushBuffer();
+
+                if (num > (size_t) bufferSize)
+                {
+                    ATTRIBUTED_STRING_STATS_PHASE (writingOutput);
+                    ATTRIBUTED_STRING_STATS_ADD (numBytesWritten, (int64) num);
+                    out.write (data, num);
+                    return;
+                }
+            }
+
+            memcpy (buffer + bufferUsed, data, num);
+            bufferUsed += num;
+        }
+
+        void put (char c)
+        {
+            if (bufferUsed == (size_t) bufferSize)
+                flushBuffer();
+
+            buffer[bufferUsed++] = c;
+        }
+
+        void flushBuffer()
+        {
+            if (bufferUsed > 0)
+            {
+                ATTRIBUTED_STRING_STATS_PHASE (writingOutput);
+                ATTRIBUTED_STRING_STATS_ADD (numBytesWritten, (int64) bufferUsed);
+                out.write (buffer, bufferUsed);
+            }
+
+            bufferUsed = 0;
+        }
+
+        //==============================================================================
+        OutputStream& out;
+        const String newLine;
+
+        enum { bufferSize = 16384 };
+        HeapBlock<char> buffer;
+        size_t bufferUsed = 0;
+        int numRunsWritten = 0;
+
+        JUCE_DECLARE_NON_COPYABLE (XmlWriter)
+    };
+}
+
+//==============================================================================
+void AttributedStringXmlWriter::write (const AttributedString& attributedString, OutputStream& stream)
+{
+    XmlWriter writer (stream);
+    writer.write (attributedString);
+}
+
+//==============================================================================
+struct AttributedStringXmlWriter::RunWriter::Pimpl
+{
+    Pimpl (OutputStream& stream)  : writer (stream) {}
+
+    XmlWriter writer;
+};
+
+AttributedStringXmlWriter::RunWriter::RunWriter (OutputStream& stream)  : pimpl (new Pimpl (stream))
+{
+}
+
+AttributedStringXmlWriter::RunWriter::~RunWriter()
+{
+}
+
+void AttributedStringXmlWriter::RunWriter::writeRun (const char* utf8, size_t numBytes, const Font& font, Colour colour)
+{
+    pimpl->writer.writeRun (utf8, numBytes, font, colour);
+}
+
+void AttributedStringXmlWriter::RunWriter::finish()
+{
+    pimpl->writer.finishRuns();
+}
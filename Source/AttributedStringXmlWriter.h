@@ -0,0 +1,49 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "AttributedRunWriter.h"
+
+//==============================================================================
+/**
+    Writes an AttributedString in the serializer's XML format straight into an
+    OutputStream.
+
+    The output is byte-for-byte what building the XmlElement tree and calling
+    XmlElement::writeToStream would produce (same indentation, attribute
+    wrapping and escaping), but nothing is built in memory: the attributes are
+    formatted into stack buffers and the text is escaped while it is copied out.
+    Runs of text which need no escaping are found 16 bytes at a time with SSE2
+    where it's available, and the output is collected in a small buffer so the
+    stream only sees large writes.
+*/
+struct AttributedStringXmlWriter
+{
+    static void write (const AttributedString& attributedString, OutputStream& stream);
+
+    /** Writes the same XML as write() a run at a time. The runs have to follow
+        each other without gaps, which they always do when they come from a loader.
+    */
+    class RunWriter  : public AttributedRunWriter
+    {
+    public:
+        RunWriter (OutputStream& stream);
+        ~RunWriter();
+
+        void writeRun (const char* utf8, size_t numBytes, const Font& font, Colour colour) override;
+        void finish() override;
+
+    private:
+        struct Pimpl;
+        ScopedPointer<Pimpl> pimpl;
+
+        JUCE_DECLARE_NON_COPYABLE (RunWriter)
+    };
+};
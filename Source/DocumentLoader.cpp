@@ -0,0 +1,183 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "DocumentLoader.h"
+#include "AttributedStringSerializer.h"
+#include "LoadProgress.h"
+
+//==============================================================================
+class DocumentLoader::Job  : public ThreadPoolJob,
+                             private LoadProgress
+{
+public:
+    Job (DocumentLoader& o, const File& f, Format fmt)
+        : ThreadPoolJob ("Document loader"), owner (o), file (f), format (fmt), totalBytes (f.getSize())
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        AttributedString* result = (format == Format::rtf ? AttributedStringSerializer::createAttributedStringFromRTFFile (file, this)
+                                                          : AttributedStringSerializer::createAttributedStringFromFile (file, this));
+        owner.jobFinished (this, result);
+        return jobHasFinished;
+    }
+
+private:
+    bool update (int64 numBytesConsumed, const AttributedStringBuilder& partialResult) override
+    {
+        if (shouldExit())
+            return false;
+
+        AttributedString* preview = nullptr;
+
+        // the first update comes before anything has been read; the next one
+        // has a whole chunk parsed, which is plenty for the first screen
+        if (! hasSentPreview && numBytesConsumed > 0)
+        {
+            preview = new AttributedString (partialResult.createSnapshot());
+            hasSentPreview = true;
+        }
+
+        owner.jobUpdated (this, totalBytes > 0 ? jlimit (0.0, 1.0, (double) numBytesConsumed / (double) totalBytes) : -1.0,
+                          preview);
+        return true;
+    }
+
+    DocumentLoader& owner;
+    const File file;
+    const Format format;
+    const int64 totalBytes;
+    bool hasSentPreview = false;
+
+    JUCE_DECLARE_NON_COPYABLE (Job)
+};
+
+//==============================================================================
+DocumentLoader::DocumentLoader (Listener& l)  : listener (l)
+{
+}
+
+DocumentLoader::~DocumentLoader()
+{
+    cancel();
+
+    // the jobs call back into this object, so they have to be gone first
+    thread.removeAllJobs (true, 10000);
+}
+
+void DocumentLoader::load (const File& file, Format format)
+{
+    cancel();
+
+    Job* job = new Job (*this, file, format);
+
+    {
+        const ScopedLock sl (lock);
+        currentJob = job;
+        currentFile = file;
+    }
+
+    thread.addJob (job, true);
+}
+
+void DocumentLoader::cancel()
+{
+    {
+        const ScopedLock sl (lock);
+
+        currentJob = nullptr;
+        pendingPreview = nullptr;
+        pendingResult = nullptr;
+        progressChanged = finished = false;
+    }
+
+    cancelPendingUpdate();
+
+    // the job notices this before it reads its next chunk, and anything it
+    // reports until then is ignored, so there's no need to wait for it here
+    thread.removeAllJobs (true, 0);
+}
+
+//==============================================================================
+void DocumentLoader::jobUpdated (Job* job, double progress, AttributedString* preview)
+{
+    ScopedPointer<AttributedString> previewDeleter (preview);
+
+    {
+        const ScopedLock sl (lock);
+
+        if (job != currentJob)
+            return;
+
+        pendingProgress = progress;
+        progressChanged = true;
+
+        if (preview != nullptr)
+            pendingPreview = previewDeleter.release();
+    }
+
+    triggerAsyncUpdate();
+}
+
+void DocumentLoader::jobFinished (Job* job, AttributedString* result)
+{
+    ScopedPointer<AttributedString> resultDeleter (result);
+
+    {
+        const ScopedLock sl (lock);
+
+        if (job != currentJob)
+            return;
+
+        pendingResult = resultDeleter.release();
+        finished = true;
+    }
+
+    triggerAsyncUpdate();
+}
+
+void DocumentLoader::handleAsyncUpdate()
+{
+    ScopedPointer<AttributedString> preview, result;
+    double progress;
+    bool hasNewProgress, hasFinished;
+
+    {
+        const ScopedLock sl (lock);
+
+        if (currentJob == nullptr)
+            return;
+
+        preview = pendingPreview.release();
+        result = pendingResult.release();
+        progress = pendingProgress;
+        hasNewProgress = progressChanged;
+        hasFinished = finished;
+
+        progressChanged = finished = false;
+
+        // the pool deletes a job as soon as it has finished
+        if (hasFinished)
+            currentJob = nullptr;
+    }
+
+    if (hasFinished)
+    {
+        listener.documentLoadProgressChanged (1.0);
+        listener.documentLoaded (currentFile, result.release());
+        return;
+    }
+
+    if (preview != nullptr)
+        listener.documentPreviewAvailable (*preview);
+
+    if (hasNewProgress)
+        listener.documentLoadProgressChanged (progress);
+}
@@ -0,0 +1,74 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    Loads documents on a background thread for the viewer.
+
+    The listener is called on the message thread: once with the first part of
+    the document as soon as it has been parsed, with the progress while the
+    rest is read, and once more when the load has finished. Starting another
+    load or calling cancel() stops the current one.
+*/
+class DocumentLoader  : private AsyncUpdater
+{
+public:
+    struct Listener
+    {
+        virtual ~Listener() {}
+
+        /** The runs parsed so far, for showing while the rest is loaded. */
+        virtual void documentPreviewAvailable (const AttributedString& firstPart) = 0;
+
+        /** Between 0 and 1, or negative if the size of the file is unknown. */
+        virtual void documentLoadProgressChanged (double progress) = 0;
+
+        /** The listener takes ownership of the document, which is nullptr if the
+            file couldn't be loaded.
+        */
+        virtual void documentLoaded (const File& file, AttributedString* newDocument) = 0;
+    };
+
+    DocumentLoader (Listener& listener);
+    ~DocumentLoader();
+
+    enum class Format { xmlOrBinary, rtf };
+
+    void load (const File& file, Format format);
+
+    /** Stops the current load, if any. The listener won't hear about it again. */
+    void cancel();
+
+    bool isLoading() const noexcept         { return currentJob != nullptr; }
+
+private:
+    //==============================================================================
+    class Job;
+
+    void jobUpdated (Job*, double progress, AttributedString* preview);
+    void jobFinished (Job*, AttributedString* result);
+    void handleAsyncUpdate() override;
+
+    Listener& listener;
+    ThreadPool thread { 1 };
+    Job* currentJob = nullptr;
+    File currentFile;
+
+    // written by the job, collected on the message thread
+    CriticalSection lock;
+    double pendingProgress = 0;
+    ScopedPointer<AttributedString> pendingPreview, pendingResult;
+    bool progressChanged = false, finished = false;
+
+    JUCE_DECLARE_NON_COPYABLE (DocumentLoader)
+};
@@ -0,0 +1,627 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "DocumentView.h"
+
+namespace
+{
+    // paragraphs longer than this are split at the next whitespace (or at twice
+    // the length if there isn't any), so that no single block is expensive to lay out
+    const int maxBlockLength = 2000;
+
+    // how long each timer callback may spend measuring off-screen blocks, and
+    // drawing tiles
+    const double measuringMillisecondsPerTick = 5.0;
+    const double renderingMillisecondsPerTick = 5.0;
+    const int timerIntervalMilliseconds = 20;
+
+    // in pixels of the content, whatever the display's scale
+    const int tileHeight = 256;
+
+    size_t getNumBytes (const Image& image) noexcept
+    {
+        return (size_t) image.getWidth() * (size_t) image.getHeight() * 4;
+    }
+}
+
+//==============================================================================
+class DocumentView::Content  : public Component
+{
+public:
+    Content (DocumentView& v)  : owner (v)
+    {
+        setOpaque (true);
+    }
+
+    void paint (Graphics& g) override
+    {
+        g.fillAll (Colours::white);
+        owner.paintBlocks (g, g.getClipBounds());
+    }
+
+private:
+    DocumentView& owner;
+
+    JUCE_DECLARE_NON_COPYABLE (Content)
+};
+
+//==============================================================================
+DocumentView::DocumentView()
+    : content (new Content (*this))
+{
+    // a vertical scrollbar that came and went would change the width and make
+    // every block need laying out again
+    setScrollBarsShown (true, false);
+
+    content->setSize (1, 1);
+    setViewedComponent (content, false);
+}
+
+DocumentView::~DocumentView()
+{
+    setViewedComponent (nullptr, false);
+}
+
+void DocumentView::setText (const AttributedString& newText)
+{
+    document = newText;
+
+    clearTiles();
+    laidOutBlocks.clear();
+    splitIntoBlocks();
+
+    layoutWidth = getMaximumVisibleWidth();
+
+    for (auto& block : blocks)
+        block.height = estimateHeight (block);
+
+    {
+        // the blocks don't have positions yet, so nothing can be laid out here
+        const ScopedValueSetter<bool> svs (isUpdating, true);
+        setViewPosition (0, 0);
+    }
+
+    updatePositions();
+    layOutVisibleBlocks();
+    content->repaint();
+
+    nextBlockToMeasure = 0;
+    startTimer (timerIntervalMilliseconds);
+}
+
+void DocumentView::setMaxTileMemory (size_t numBytes)
+{
+    maxTileMemory = numBytes;
+    evictTiles (maxTileMemory);
+}
+
+//==============================================================================
+void DocumentView::resized()
+{
+    Viewport::resized();
+
+    const int newWidth = getMaximumVisibleWidth();
+
+    if (newWidth == layoutWidth)
+        return;
+
+    layoutWidth = newWidth;
+    clearTiles();
+    laidOutBlocks.clear();
+
+    for (auto& block : blocks)
+    {
+        block.height = estimateHeight (block);
+        block.isEstimate = true;
+    }
+
+    updatePositions();
+    layOutVisibleBlocks();
+
+    nextBlockToMeasure = 0;
+    startTimer (timerIntervalMilliseconds);
+}
+
+void DocumentView::visibleAreaChanged (const Rectangle<int>&)
+{
+    if (! isUpdating)
+        layOutVisibleBlocks();
+}
+
+//==============================================================================
+void DocumentView::splitIntoBlocks()
+{
+    blocks.clearQuick();
+
+    const String& text = document.getText();
+    const char* const base = text.toRawUTF8();
+
+    Block block = { 0, 0, 0, 0, 0, 0, 0, true };
+    CharPointer_UTF8 p (base);
+    int index = 0;
+
+    while (! p.isEmpty())
+    {
+        const juce_wchar c = p.getAndAdvance();
+        const int length = ++index - block.start;
+
+        if (c == '\n' || (length >= maxBlockLength && CharacterFunctions::isWhitespace (c))
+                      || length >= 2 * maxBlockLength)
+        {
+            block.end = index;
+            block.endByte = (size_t) (p.getAddress() - base);
+            blocks.add (block);
+
+            block.start = index;
+            block.startByte = block.endByte;
+        }
+    }
+
+    if (index > block.start)
+    {
+        block.end = index;
+        block.endByte = (size_t) (p.getAddress() - base);
+        blocks.add (block);
+    }
+
+    // the attributes are in text order, so one pass finds the first one of each block
+    int attributeIndex = 0;
+
+    for (auto& b : blocks)
+    {
+        while (attributeIndex < document.getNumAttributes()
+                && document.getAttribute (attributeIndex).range.getEnd() <= b.start)
+            ++attributeIndex;
+
+        b.firstAttribute = attributeIndex;
+    }
+}
+
+void DocumentView::createBlockString (const Block& block, AttributedString& s) const
+{
+    s.setJustification (document.getJustification());
+    s.setWordWrap (document.getWordWrap());
+    s.setReadingDirection (document.getReadingDirection());
+    s.setLineSpacing (document.getLineSpacing());
+
+    CharPointer_UTF8 p (document.getText().toRawUTF8() + block.startByte);
+    int index = block.start;
+
+    for (int i = block.firstAttribute; i < document.getNumAttributes(); ++i)
+    {
+        const AttributedString::Attribute& attr = document.getAttribute (i);
+
+        if (attr.range.getStart() >= block.end)
+            break;
+
+        const int start = jmax (attr.range.getStart(), block.start);
+        const int end   = jmin (attr.range.getEnd(), block.end);
+
+        if (start >= end)
+            continue;
+
+        // like TextLayout, this leaves out any text that no attribute covers
+        for (; index < start; ++index)
+            ++p;
+
+        const CharPointer_UTF8 spanStart (p);
+
+        for (; index < end; ++index)
+            ++p;
+
+        s.append (String (spanStart, p), attr.font, attr.colour);
+    }
+}
+
+int DocumentView::estimateHeight (const Block& block) const
+{
+    const Font font (isPositiveAndBelow (block.firstAttribute, document.getNumAttributes())
+                        ? document.getAttribute (block.firstAttribute).font : Font());
+
+    // assumes that the average character is about half an em wide
+    const float charactersPerLine = jmax (1.0f, (float) layoutWidth / (font.getHeight() * 0.5f));
+    const int numLines = jmax (1, (int) std::ceil ((float) (block.end - block.start) / charactersPerLine));
+
+    return jmax (1, roundToInt ((float) numLines * font.getHeight()));
+}
+
+int DocumentView::findBlockAt (int y) const
+{
+    int low = 0, high = blocks.size();
+
+    while (low < high)
+    {
+        const int mid = (low + high) / 2;
+
+        if (blocks.getReference (mid).y <= y)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return blocks.isEmpty() ? -1 : jmax (0, low - 1);
+}
+
+//==============================================================================
+DocumentView::LaidOutBlock* DocumentView::findLaidOutBlock (int blockIndex) const noexcept
+{
+    for (auto* laidOut : laidOutBlocks)
+        if (laidOut->blockIndex == blockIndex)
+            return laidOut;
+
+    return nullptr;
+}
+
+void DocumentView::layOutBlock (Block& block, TextLayout& layout) const
+{
+    AttributedString s;
+    createBlockString (block, s);
+
+    layout.createLayout (s, (float) layoutWidth);
+
+    block.height = jmax (1, (int) std::ceil (layout.getHeight()));
+    block.isEstimate = false;
+}
+
+void DocumentView::layOutVisibleBlocks()
+{
+    if (blocks.isEmpty() || layoutWidth <= 0)
+        return;
+
+    bool needsRepaint = false;
+
+    // laying out a block can change its height and move the ones after it into
+    // or out of view, so this takes a few passes to settle
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        const Rectangle<int> view (getViewArea());
+        bool heightsChanged = false;
+
+        for (int i = findBlockAt (view.getY() - view.getHeight()); i < blocks.size(); ++i)
+        {
+            Block& block = blocks.getReference (i);
+
+            if (block.y >= view.getBottom() + view.getHeight())
+                break;
+
+            if (findLaidOutBlock (i) != nullptr)
+                continue;
+
+            LaidOutBlock* laidOut = laidOutBlocks.add (new LaidOutBlock());
+            laidOut->blockIndex = i;
+
+            const int oldHeight = block.height;
+            layOutBlock (block, laidOut->layout);
+
+            heightsChanged = heightsChanged || block.height != oldHeight;
+            needsRepaint = true;
+        }
+
+        if (! heightsChanged)
+            break;
+
+        updatePositions();
+    }
+
+    // forget the layouts which are well out of sight
+    const Rectangle<int> view (getViewArea());
+
+    for (int i = laidOutBlocks.size(); --i >= 0;)
+    {
+        const Block& block = blocks.getReference (laidOutBlocks.getUnchecked (i)->blockIndex);
+
+        if (block.y + block.height < view.getY() - 3 * view.getHeight()
+             || block.y > view.getBottom() + 3 * view.getHeight())
+            laidOutBlocks.remove (i);
+    }
+
+    cancelDistantTiles (view);
+    requestTilesAround (view);
+
+    if (needsRepaint)
+        content->repaint();
+}
+
+void DocumentView::updatePositions()
+{
+    // keeps the block at the top of the view in place, so that the text doesn't
+    // jump when the blocks above it turn out to be taller or shorter than estimated
+    const int viewY = getViewPositionY();
+    const int anchor = findBlockAt (viewY);
+    const int offset = anchor >= 0 ? viewY - blocks.getReference (anchor).y : 0;
+
+    int y = 0;
+
+    for (auto& block : blocks)
+    {
+        block.y = y;
+        y += block.height;
+    }
+
+    const ScopedValueSetter<bool> svs (isUpdating, true);
+
+    content->setSize (jmax (1, layoutWidth), jmax (1, y));
+
+    if (anchor >= 0)
+    {
+        const Block& block = blocks.getReference (anchor);
+        setViewPosition (0, block.y + jlimit (0, block.height, offset));
+    }
+}
+
+void DocumentView::paintBlocks (Graphics& g, const Rectangle<int>& area)
+{
+    const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+
+    // on a display with a different scale the tiles would be blurred or wasteful
+    if (scale != tileScale)
+    {
+        clearTiles();
+        tileScale = scale;
+    }
+
+    const int bottom = jmin (area.getBottom(), content->getHeight());
+
+    for (int y = jmax (0, area.getY()); y < bottom;)
+    {
+        const int index = findTileAt (tiles, y);
+
+        if (index >= 0)
+        {
+            Tile& tile = tiles.getReference (index);
+            tile.lastUsed = ++tileCounter;
+
+            const int tileY = getTileY (tile);
+
+            if (scale == 1.0f)
+                g.drawImageAt (tile.image, 0, tileY);
+            else
+                g.drawImageTransformed (tile.image, AffineTransform::scale (1.0f / scale).translated (0.0f, (float) tileY));
+
+            y = tileY + tileHeight;
+            continue;
+        }
+
+        // draws the part up to the next tile straight from the layouts, and has
+        // tiles of it rendered for next time
+        const int start = y;
+
+        while (y < bottom && findTileAt (tiles, y) < 0)
+        {
+            int end = requestTileAt (y);
+
+            for (auto& tile : tiles)
+            {
+                const int tileY = getTileY (tile);
+
+                if (tileY > y && tileY < end)
+                    end = tileY;
+            }
+
+            y = end;
+        }
+
+        drawBlocks (g, start, y);
+    }
+}
+
+void DocumentView::drawBlocks (Graphics& g, int top, int bottom)
+{
+    // a block which sticks out would otherwise be drawn again over a tile's text
+    Graphics::ScopedSaveState state (g);
+    g.reduceClipRegion (0, top, jmax (1, layoutWidth), bottom - top);
+
+    for (int i = jmax (0, findBlockAt (top)); i < blocks.size(); ++i)
+    {
+        const Block& block = blocks.getReference (i);
+
+        if (block.y >= bottom)
+            break;
+
+        if (LaidOutBlock* laidOut = findLaidOutBlock (i))
+            laidOut->layout.draw (g, Rectangle<float> (0.0f, (float) block.y, (float) layoutWidth, (float) block.height));
+    }
+}
+
+//==============================================================================
+int DocumentView::getTileY (const Tile& tile) const noexcept
+{
+    return blocks.getReference (tile.firstBlock).y + tile.offset;
+}
+
+int DocumentView::findTileAt (const Array<Tile>& tilesToSearch, int y) const noexcept
+{
+    for (int i = 0; i < tilesToSearch.size(); ++i)
+    {
+        const int tileY = getTileY (tilesToSearch.getReference (i));
+
+        if (tileY <= y && y < tileY + tileHeight)
+            return i;
+    }
+
+    return -1;
+}
+
+int DocumentView::requestTileAt (int y)
+{
+    {
+        const int index = findTileAt (tiles, y);
+
+        if (index >= 0)
+            return getTileY (tiles.getReference (index)) + tileHeight;
+    }
+
+    {
+        const int index = findTileAt (requestedTiles, y);
+
+        if (index >= 0)
+            return getTileY (requestedTiles.getReference (index)) + tileHeight;
+    }
+
+    const int first = findBlockAt (y);
+
+    if (first < 0 || layoutWidth <= 0)
+        return y + tileHeight;
+
+    for (int i = first; i < blocks.size(); ++i)
+    {
+        if (blocks.getReference (i).y >= y + tileHeight)
+            break;
+
+        // it's asked for again once the block has been laid out; a laid-out block
+        // has been measured, so its height only changes with the width
+        if (findLaidOutBlock (i) == nullptr)
+            return y + tileHeight;
+    }
+
+    const Tile tile = { first, y - blocks.getReference (first).y, 0, Image() };
+    requestedTiles.add (tile);
+
+    if (! isTimerRunning())
+        startTimer (timerIntervalMilliseconds);
+
+    return y + tileHeight;
+}
+
+void DocumentView::requestTilesAround (const Rectangle<int>& view)
+{
+    // a screen either way, which is as far as the blocks are laid out
+    const int bottom = jmin (content->getHeight(), view.getBottom() + view.getHeight());
+
+    for (int y = jmax (0, view.getY() - view.getHeight()); y < bottom;)
+        y = requestTileAt (y);
+}
+
+void DocumentView::cancelDistantTiles (const Rectangle<int>& view)
+{
+    for (int i = requestedTiles.size(); --i >= 0;)
+    {
+        const int tileY = getTileY (requestedTiles.getReference (i));
+
+        if (tileY + tileHeight < view.getY() - 3 * view.getHeight()
+             || tileY > view.getBottom() + 3 * view.getHeight())
+            requestedTiles.remove (i);
+    }
+}
+
+bool DocumentView::renderTile (Tile& tile)
+{
+    const int y = getTileY (tile);
+
+    Image image (Image::RGB, jmax (1, roundToInt ((float) layoutWidth * tileScale)),
+                 roundToInt ((float) tileHeight * tileScale), false);
+
+    {
+        Graphics g (image);
+        g.fillAll (Colours::white);
+        g.addTransform (AffineTransform::scale (tileScale));
+
+        for (int i = tile.firstBlock; i < blocks.size(); ++i)
+        {
+            const Block& block = blocks.getReference (i);
+
+            if (block.y >= y + tileHeight)
+                break;
+
+            // the layout may have been forgotten since the tile was asked for, in
+            // which case it's asked for again if the block comes back into view
+            LaidOutBlock* laidOut = findLaidOutBlock (i);
+
+            if (laidOut == nullptr)
+                return false;
+
+            laidOut->layout.draw (g, Rectangle<float> (0.0f, (float) (block.y - y),
+                                                       (float) layoutWidth, (float) block.height));
+        }
+    }
+
+    tile.image = image;
+    return true;
+}
+
+void DocumentView::clearTiles()
+{
+    tiles.clear();
+    requestedTiles.clear();
+}
+
+void DocumentView::evictTiles (size_t maxBytes)
+{
+    size_t numBytes = 0;
+
+    for (auto& tile : tiles)
+        numBytes += getNumBytes (tile.image);
+
+    while (numBytes > maxBytes && tiles.size() > 0)
+    {
+        int oldest = 0;
+
+        for (int i = 1; i < tiles.size(); ++i)
+            if (tiles.getReference (i).lastUsed < tiles.getReference (oldest).lastUsed)
+                oldest = i;
+
+        numBytes -= getNumBytes (tiles.getReference (oldest).image);
+        tiles.remove (oldest);
+    }
+}
+
+//==============================================================================
+void DocumentView::measureBlocks()
+{
+    const double endTime = Time::getMillisecondCounterHiRes() + measuringMillisecondsPerTick;
+    bool heightsChanged = false;
+
+    while (nextBlockToMeasure < blocks.size() && Time::getMillisecondCounterHiRes() < endTime)
+    {
+        Block& block = blocks.getReference (nextBlockToMeasure++);
+
+        if (block.isEstimate)
+        {
+            TextLayout layout;
+            layOutBlock (block, layout);
+            heightsChanged = true;
+        }
+    }
+
+    if (heightsChanged)
+    {
+        updatePositions();
+        layOutVisibleBlocks();
+    }
+}
+
+void DocumentView::renderRequestedTiles()
+{
+    const double endTime = Time::getMillisecondCounterHiRes() + renderingMillisecondsPerTick;
+
+    while (requestedTiles.size() > 0 && Time::getMillisecondCounterHiRes() < endTime)
+    {
+        Tile tile (requestedTiles.getReference (0));
+        requestedTiles.remove (0);
+
+        // it shows the same as what was drawn straight from the layouts, so
+        // there's nothing to repaint
+        if (renderTile (tile))
+        {
+            tile.lastUsed = ++tileCounter;
+            tiles.add (tile);
+        }
+    }
+
+    evictTiles (maxTileMemory);
+}
+
+void DocumentView::timerCallback()
+{
+    measureBlocks();
+    renderRequestedTiles();
+
+    if (nextBlockToMeasure >= blocks.size() && requestedTiles.isEmpty())
+        stopTimer();
+}
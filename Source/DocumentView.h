@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    A scrollable view of an AttributedString which stays responsive for very
+    long documents.
+
+    The text is split into paragraph blocks, and only the blocks in or near the
+    visible area are laid out. The other blocks start off with estimated heights,
+    which a timer replaces with measured ones a few blocks at a time. When the
+    width changes, only the blocks which are visible or about to be are laid out
+    again straight away.
+
+    The laid-out text is drawn into image tiles of a fixed height, for the screen
+    around the visible area, so that scrolling only has to blit them. Like the
+    measuring, the drawing is done by the timer a few tiles at a time, because
+    TextLayout and the typefaces behind it belong to the message thread. A tile
+    is anchored to the block it starts in, so it stays valid when estimated
+    heights above it are replaced, and the tiles are only thrown away when the
+    text, the width or the display scale changes. Until a tile is ready, its
+    part of the view is drawn straight from the layouts. The least recently
+    drawn tiles are evicted once they use more than the memory limit.
+*/
+class DocumentView  : public Viewport,
+                      private Timer
+{
+public:
+    DocumentView();
+    ~DocumentView();
+
+    /** Shows a copy of the string, scrolled to the top. */
+    void setText (const AttributedString& newText);
+
+    /** The most memory which the rendered tiles may use. The default is 64 MB.
+        Lowering it evicts tiles straight away.
+    */
+    void setMaxTileMemory (size_t numBytes);
+
+    //==============================================================================
+    /** @internal */
+    void resized() override;
+    /** @internal */
+    void visibleAreaChanged (const Rectangle<int>& newVisibleArea) override;
+
+private:
+    //==============================================================================
+    struct Block
+    {
+        int start, end;                 // in characters
+        size_t startByte, endByte;      // in the text's UTF-8
+        int firstAttribute;
+        int y, height;
+        bool isEstimate;
+    };
+
+    struct LaidOutBlock
+    {
+        int blockIndex;
+        TextLayout layout;
+    };
+
+    struct Tile
+    {
+        int firstBlock, offset;     // the tile's top is this far into its first block
+        int64 lastUsed;
+        Image image;                // null until the timer has drawn it
+    };
+
+    class Content;
+
+    void splitIntoBlocks();
+    void createBlockString (const Block&, AttributedString&) const;
+    int estimateHeight (const Block&) const;
+    int findBlockAt (int y) const;
+
+    LaidOutBlock* findLaidOutBlock (int blockIndex) const noexcept;
+    void layOutBlock (Block&, TextLayout&) const;
+    void layOutVisibleBlocks();
+    void updatePositions();
+    void paintBlocks (Graphics&, const Rectangle<int>& area);
+    void drawBlocks (Graphics&, int top, int bottom);
+
+    int getTileY (const Tile&) const noexcept;
+    int findTileAt (const Array<Tile>&, int y) const noexcept;
+    int requestTileAt (int y);
+    void requestTilesAround (const Rectangle<int>& view);
+    void cancelDistantTiles (const Rectangle<int>& view);
+    bool renderTile (Tile&);
+    void clearTiles();
+    void evictTiles (size_t maxBytes);
+
+    void measureBlocks();
+    void renderRequestedTiles();
+    void timerCallback() override;
+
+    //==============================================================================
+    AttributedString document;
+    Array<Block> blocks;
+    OwnedArray<LaidOutBlock> laidOutBlocks;
+    ScopedPointer<Content> content;
+
+    int layoutWidth = 0, nextBlockToMeasure = 0;
+    bool isUpdating = false;
+
+    Array<Tile> tiles;
+    float tileScale = 1.0f;
+    size_t maxTileMemory = 64 * 1024 * 1024;
+    int64 tileCounter = 0;
+
+    // the tiles which the timer still has to draw
+    Array<Tile> requestedTiles;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DocumentView)
+};
@@ -0,0 +1,62 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "EmbeddedData.h"
+
+namespace
+{
+    const char* const fileNamePatterns = "picture-*;object-*;theme-*";
+
+    static const char* getName (EmbeddedDataHandler::Kind kind) noexcept
+    {
+        switch (kind)
+        {
+            case EmbeddedDataHandler::Kind::picture:    return "picture";
+            case EmbeddedDataHandler::Kind::object:     return "object";
+            case EmbeddedDataHandler::Kind::theme:      return "theme";
+            default:                                    break;
+        }
+
+        return "item";
+    }
+}
+
+//==============================================================================
+EmbeddedDataFileWriter::EmbeddedDataFileWriter (const File& d)  : directory (d)
+{
+}
+
+OutputStream* EmbeddedDataFileWriter::createOutputStream (Kind kind, const String& fileExtension)
+{
+    if (files.isEmpty() && directory.createDirectory().failed())
+        return nullptr;
+
+    const File file (directory.getChildFile (String (getName (kind)) + "-" + String (files.size() + 1) + "." + fileExtension));
+
+    ScopedPointer<FileOutputStream> out (new FileOutputStream (file));
+
+    if (out->failedToOpen())
+        return nullptr;
+
+    // FileOutputStream appends to an existing file
+    out->setPosition (0);
+    out->truncate();
+
+    files.add (file);
+    return out.release();
+}
+
+void EmbeddedDataFileWriter::deleteOldFiles() const
+{
+    Array<File> oldFiles;
+    directory.findChildFiles (oldFiles, File::findFiles, false, fileNamePatterns);
+
+    for (auto& file : oldFiles)
+        file.deleteFile();
+}
@@ -0,0 +1,69 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    Receives the embedded data which the RTF reader skips: the pictures, OLE
+    objects and themes which an AttributedString can't hold.
+
+    Without a handler, the reader skips them without decoding anything. With one,
+    it decodes each item's hex (or \bin bytes) as it goes and writes them to the
+    stream which the handler creates for it, so that nothing is kept in memory.
+*/
+class EmbeddedDataHandler
+{
+public:
+    virtual ~EmbeddedDataHandler() {}
+
+    enum class Kind
+    {
+        picture,
+        object,         // the OLE data of an \object
+        theme           // Word's \themedata
+    };
+
+    /** Called on the loading thread when an item's data starts. The extension
+        (without a dot) suits the item's format, e.g. "png", "emf" or "bin" if
+        it's unknown. Return nullptr to skip the item. The reader deletes the
+        stream when the item ends.
+    */
+    virtual OutputStream* createOutputStream (Kind kind, const String& fileExtension) = 0;
+};
+
+//==============================================================================
+/**
+    Writes each embedded item to a numbered file in a directory, e.g.
+    "picture-1.png" or "object-2.bin". The directory is created for the first
+    item, so documents without any don't leave an empty one behind.
+*/
+class EmbeddedDataFileWriter  : public EmbeddedDataHandler
+{
+public:
+    explicit EmbeddedDataFileWriter (const File& directory);
+
+    OutputStream* createOutputStream (Kind kind, const String& fileExtension) override;
+
+    /** The files which have been written so far. */
+    const Array<File>& getFiles() const noexcept        { return files; }
+
+    /** Deletes the files which an earlier writer left in the directory, so that
+        a document with fewer items than before doesn't keep the old extra ones.
+    */
+    void deleteOldFiles() const;
+
+private:
+    const File directory;
+    Array<File> files;
+
+    JUCE_DECLARE_NON_COPYABLE (EmbeddedDataFileWriter)
+};
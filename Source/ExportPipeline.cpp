@@ -0,0 +1,229 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "ExportPipeline.h"
+#include "AttributedStringSerializer.h"
+#include "LoadLimits.h"
+
+//==============================================================================
+/** The runs which the loader completed during one chunk of the input, with a
+    copy of their text. Every stage shares the same batch.
+*/
+struct ExportPipeline::RunBatch  : public ReferenceCountedObject
+{
+    typedef ReferenceCountedObjectPtr<RunBatch> Ptr;
+
+    struct Run
+    {
+        size_t offset, numBytes;    // into text
+        Font font;
+        Colour colour;
+    };
+
+    Utf8Buffer text;
+    Array<Run> runs;
+};
+
+//==============================================================================
+class ExportPipeline::Stage  : public ThreadPoolJob
+{
+public:
+    Stage (AttributedRunWriter& w)  : ThreadPoolJob ("Export stage"), writer (w)
+    {
+    }
+
+    /** Called by the loading thread, which waits here while the queue is full. */
+    void push (RunBatch* batch)
+    {
+        for (;;)
+        {
+            {
+                const ScopedLock sl (lock);
+
+                if (queue.size() < maxQueuedBatches)
+                {
+                    queue.add (batch);
+                    break;
+                }
+            }
+
+            spaceAvailable.wait();
+        }
+
+        batchAvailable.signal();
+    }
+
+    /** Lets the writer finish once it has written everything which was pushed. */
+    void close()
+    {
+        {
+            const ScopedLock sl (lock);
+            isClosed = true;
+        }
+
+        batchAvailable.signal();
+    }
+
+    JobStatus runJob() override
+    {
+        for (;;)
+        {
+            RunBatch::Ptr batch;
+
+            {
+                const ScopedLock sl (lock);
+
+                if (queue.size() > 0)
+                {
+                    batch = queue.getFirst();
+                    queue.remove (0);
+                }
+                else if (isClosed)
+                {
+                    break;
+                }
+            }
+
+            if (batch == nullptr)
+            {
+                batchAvailable.wait();
+                continue;
+            }
+
+            spaceAvailable.signal();
+
+            const char* const text = batch->text.getData();
+
+            for (auto& run : batch->runs)
+                writer.writeRun (text + run.offset, run.numBytes, run.font, run.colour);
+        }
+
+        writer.finish();
+        return jobHasFinished;
+    }
+
+private:
+    // a few chunks' worth, so that a writer can catch up after a slow moment
+    enum { maxQueuedBatches = 8 };
+
+    AttributedRunWriter& writer;
+
+    CriticalSection lock;
+    Array<RunBatch::Ptr> queue;
+    bool isClosed = false;
+    WaitableEvent batchAvailable, spaceAvailable;
+
+    JUCE_DECLARE_NON_COPYABLE (Stage)
+};
+
+//==============================================================================
+ExportPipeline::ExportPipeline()
+{
+}
+
+ExportPipeline::~ExportPipeline()
+{
+}
+
+void ExportPipeline::addWriter (AttributedRunWriter* writer)
+{
+    jassert (writer != nullptr && pool == nullptr);
+    writers.add (writer);
+}
+
+Result ExportPipeline::run (const File& input, LoadLimits* limits)
+{
+    startStages();
+
+    ScopedPointer<AttributedString> result (input.hasFileExtension ("rtf")
+                                              ? AttributedStringSerializer::createAttributedStringFromRTFFile (input, this, limits)
+                                              : AttributedStringSerializer::createAttributedStringFromFile (input, this, limits));
+
+    return finishStages (result, limits, input.getFullPathName());
+}
+
+Result ExportPipeline::run (InputStream& input, bool isRtf, LoadLimits* limits)
+{
+    startStages();
+
+    ScopedPointer<AttributedString> result (isRtf ? AttributedStringSerializer::createAttributedStringFromRTFData (input, this, limits)
+                                                  : AttributedStringSerializer::createAttributedStringFromInputStream (input, this, limits));
+
+    return finishStages (result, limits, "the document");
+}
+
+//==============================================================================
+void ExportPipeline::startStages()
+{
+    currentBatch = nullptr;
+    pool = new ThreadPool (jmax (1, writers.size()));
+
+    for (auto* writer : writers)
+        pool->addJob (stages.add (new Stage (*writer)), false);
+}
+
+Result ExportPipeline::finishStages (const AttributedString* result, LoadLimits* limits, const String& inputName)
+{
+    // the runs of the last chunk, and all of a document which the loader didn't stream
+    forwardBatch();
+
+    if (result != nullptr)
+    {
+        AttributedRunWriter::writeAll (*result, *this);
+        forwardBatch();
+    }
+
+    for (auto* stage : stages)
+        stage->close();
+
+    for (auto* stage : stages)
+        pool->waitForJobToFinish (stage, -1);
+
+    pool = nullptr;
+    stages.clear();
+
+    if (result != nullptr)
+        return Result::ok();
+
+    if (limits != nullptr && limits->wasExceeded())
+        return Result::fail (limits->getErrorMessage());
+
+    return Result::fail ("couldn't read " + inputName);
+}
+
+bool ExportPipeline::update (int64, const AttributedStringBuilder&)
+{
+    forwardBatch();
+    return true;
+}
+
+void ExportPipeline::writeRun (const char* utf8, size_t numBytes, const Font& font, Colour colour)
+{
+    if (stages.isEmpty())
+        return;
+
+    if (currentBatch == nullptr)
+        currentBatch = new RunBatch();
+
+    const RunBatch::Run run = { currentBatch->text.getSize(), numBytes, font, colour };
+    currentBatch->runs.add (run);
+    currentBatch->text.append (utf8, numBytes);
+}
+
+void ExportPipeline::forwardBatch()
+{
+    if (currentBatch == nullptr)
+        return;
+
+    RunBatch::Ptr batch (currentBatch);
+    currentBatch = nullptr;
+
+    for (auto* stage : stages)
+        stage->push (batch);
+}
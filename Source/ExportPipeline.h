@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "AttributedRunWriter.h"
+#include "LoadProgress.h"
+
+class LoadLimits;
+
+//==============================================================================
+/**
+    Parses a document once and writes it in several formats at the same time.
+
+    Each AttributedRunWriter gets a thread of its own. The loader hands each run
+    to the pipeline as it completes it, rather than building an AttributedString,
+    and as it finishes each chunk of the input the runs are handed to every
+    writer as a batch through a short queue, so that the writers work on the
+    beginning of the document while the rest is still being parsed. A writer
+    which falls behind makes the loader wait rather than letting its queue grow.
+    So for RTF and XML input, the memory used depends on the chunk size and the
+    queue length rather than the size of the document; a binary document is
+    loaded whole before it's written.
+
+    Writing to three formats like this takes about as long as the parse plus the
+    slowest of the writers, rather than the parse plus all of them.
+
+    e.g.
+    @code
+    FileOutputStream xml (..), text (..), html (..);
+
+    ExportPipeline pipeline;
+    pipeline.addWriter (new AttributedStringXmlWriter::RunWriter (xml));
+    pipeline.addWriter (new AttributedStringTextWriter::PlainTextRunWriter (text));
+    pipeline.addWriter (new AttributedStringTextWriter::HtmlRunWriter (html));
+
+    const Result result (pipeline.run (rtfFile));
+    @endcode
+*/
+class ExportPipeline  : private LoadProgress,
+                        private AttributedRunWriter
+{
+public:
+    ExportPipeline();
+    ~ExportPipeline();
+
+    /** The pipeline takes ownership of the writer. */
+    void addWriter (AttributedRunWriter* writer);
+
+    /** Loads an RTF file, or an XML or binary one, and writes it with each of the
+        writers. A document which can't be loaded, or which exceeds the limits,
+        makes this return an error, and the writers' output is incomplete.
+    */
+    Result run (const File& input, LoadLimits* limits = nullptr);
+    Result run (InputStream& input, bool isRtf, LoadLimits* limits = nullptr);
+
+private:
+    //==============================================================================
+    struct RunBatch;
+    class Stage;
+
+    bool update (int64 numBytesConsumed, const AttributedStringBuilder& partialResult) override;
+    AttributedRunWriter* getRunWriter() override        { return this; }
+
+    void writeRun (const char* utf8, size_t numBytes, const Font& font, Colour colour) override;
+    void finish() override {}
+
+    void startStages();
+    Result finishStages (const AttributedString* result, LoadLimits* limits, const String& inputName);
+    void forwardBatch();
+
+    OwnedArray<AttributedRunWriter> writers;
+    OwnedArray<Stage> stages;
+    ScopedPointer<ThreadPool> pool;
+
+    // the runs which the loader has completed since the last batch was handed on
+    ReferenceCountedObjectPtr<RunBatch> currentBatch;
+
+    JUCE_DECLARE_NON_COPYABLE (ExportPipeline)
+};
@@ -0,0 +1,220 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "FontCache.h"
+#include "SerializerStats.h"
+
+juce_ImplementSingleton (FontCache)
+
+FontCache::FontCache()
+{
+}
+
+FontCache::~FontCache()
+{
+    clearSingletonInstance();
+}
+
+//==============================================================================
+Font FontCache::getFont (const String& family, float height, int styleFlags, LastFont* lastFont)
+{
+    return getFont (family, height, styleFlags, false, lastFont);
+}
+
+Font FontCache::getFontWithPointHeight (const String& family, float pointHeight, int styleFlags, LastFont* lastFont)
+{
+    return getFont (family, pointHeight, styleFlags, true, lastFont);
+}
+
+Font FontCache::getFont (const String& family, float height, int styleFlags, bool isPointHeight, LastFont* lastFont)
+{
+    if (lastFont == nullptr)
+        return findOrCreateFont (family, height, styleFlags, isPointHeight);
+
+    // runs usually share their font with the run before, and the caller's own
+    // copy of it can be checked without the lock
+    if (lastFont->isValid && lastFont->styleFlags == styleFlags && lastFont->isPointHeight == isPointHeight
+         && lastFont->height == height && lastFont->family == family)
+    {
+        ATTRIBUTED_STRING_STATS_ADD (numFontCacheHits, 1);
+        return lastFont->font;
+    }
+
+    lastFont->font = findOrCreateFont (family, height, styleFlags, isPointHeight);
+    lastFont->family = family;
+    lastFont->height = height;
+    lastFont->styleFlags = styleFlags;
+    lastFont->isPointHeight = isPointHeight;
+    lastFont->isValid = true;
+
+    return lastFont->font;
+}
+
+Font FontCache::findOrCreateFont (const String& family, float height, int styleFlags, bool isPointHeight)
+{
+    uint32 heightBits;
+    memcpy (&heightBits, &height, sizeof (heightBits));
+
+    const int64 hash = family.hashCode64() ^ ((int64) heightBits << 8) ^ (styleFlags | (isPointHeight ? 0x80 : 0));
+
+    const ScopedLock sl (lock);
+
+    int index = entryIndexes.contains (hash) ? entryIndexes[hash] : -1;
+
+    // the map only holds one entry for each hash, so a different font with the
+    // same hash has to be searched for
+    if (index >= 0 && ! entries.getReference (index).matches (family, height, styleFlags, isPointHeight, hash))
+    {
+        index = -1;
+
+        for (int i = 0; i < entries.size() && index < 0; ++i)
+            if (entries.getReference (i).matches (family, height, styleFlags, isPointHeight, hash))
+                index = i;
+    }
+
+    if (index >= 0)
+    {
+        unlink (index);
+        linkAsMostRecent (index);
+        ++stats.numHits;
+        ATTRIBUTED_STRING_STATS_ADD (numFontCacheHits, 1);
+        return entries.getReference (index).font;
+    }
+
+    ++stats.numMisses;
+    ATTRIBUTED_STRING_STATS_ADD (numFontsCreated, 1);
+
+    // the typeface lookup happens in here, which is why it's worth caching
+    const Font font (isPointHeight ? Font (family, 12.0f, styleFlags).withPointHeight (height)
+                                   : Font (family, height, styleFlags));
+
+    const Entry e = { family, height, styleFlags, isPointHeight, hash, -1, -1, font };
+
+    if (entries.size() < maxNumFonts)
+    {
+        addEntry (e);
+        return font;
+    }
+
+    // the new font takes over the least recently used one's slot, so that no
+    // other entry moves
+    index = leastRecent;
+    unlink (index);
+    ++stats.numEvictions;
+
+    const int64 oldHash = entries.getReference (index).hash;
+
+    if (entryIndexes.contains (oldHash) && entryIndexes[oldHash] == index)
+        entryIndexes.remove (oldHash);
+
+    entries.getReference (index) = e;
+    linkAsMostRecent (index);
+
+    if (! entryIndexes.contains (hash))
+        entryIndexes.set (hash, index);
+
+    return font;
+}
+
+void FontCache::addEntry (const Entry& e)
+{
+    const int index = entries.size();
+    entries.add (e);
+    linkAsMostRecent (index);
+
+    if (! entryIndexes.contains (e.hash))
+        entryIndexes.set (e.hash, index);
+
+    // the HashMap doesn't grow its table by itself
+    if (entryIndexes.size() > entryIndexes.getNumSlots())
+        entryIndexes.remapTable (entryIndexes.size() * 2);
+}
+
+void FontCache::linkAsMostRecent (int index) noexcept
+{
+    Entry& e = entries.getReference (index);
+    e.previous = -1;
+    e.next = mostRecent;
+
+    if (mostRecent >= 0)
+        entries.getReference (mostRecent).previous = index;
+    else
+        leastRecent = index;
+
+    mostRecent = index;
+}
+
+void FontCache::unlink (int index) noexcept
+{
+    Entry& e = entries.getReference (index);
+
+    if (e.previous >= 0)
+        entries.getReference (e.previous).next = e.next;
+    else
+        mostRecent = e.next;
+
+    if (e.next >= 0)
+        entries.getReference (e.next).previous = e.previous;
+    else
+        leastRecent = e.previous;
+}
+
+void FontCache::keepMostRecent (int numToKeep)
+{
+    if (entries.size() <= numToKeep)
+        return;
+
+    Array<Entry> kept;
+
+    for (int i = mostRecent; i >= 0 && kept.size() < numToKeep; i = entries.getReference (i).next)
+        kept.add (entries.getReference (i));
+
+    stats.numEvictions += entries.size() - kept.size();
+
+    entries.clearQuick();
+    entryIndexes.clear();
+    mostRecent = leastRecent = -1;
+
+    // added least recent first, so that each one goes in front of the ones before
+    for (int i = kept.size(); --i >= 0;)
+        addEntry (kept.getReference (i));
+}
+
+//==============================================================================
+FontCache::Statistics FontCache::getStatistics() const
+{
+    const ScopedLock sl (lock);
+
+    Statistics s (stats);
+    s.numFonts = entries.size();
+    return s;
+}
+
+void FontCache::resetStatistics()
+{
+    const ScopedLock sl (lock);
+    stats = Statistics();
+}
+
+void FontCache::setMaxNumFonts (int newMaxNumFonts)
+{
+    const ScopedLock sl (lock);
+
+    maxNumFonts = jmax (1, newMaxNumFonts);
+    keepMostRecent (maxNumFonts);
+}
+
+void FontCache::clear()
+{
+    const ScopedLock sl (lock);
+
+    entries.clear();
+    entryIndexes.clear();
+    mostRecent = leastRecent = -1;
+}
@@ -0,0 +1,112 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    Hands out shared Font objects for the loaders, so that a document which uses
+    a dozen fonts only looks up a dozen typefaces, however many runs it has and
+    however many documents are loaded.
+
+    Fonts are keyed by family, height and style. Fonts whose height is given in
+    points are kept apart from ones whose height is given in JUCE's units, as
+    converting a point height needs the typeface's metrics. The cache is safe to
+    use from several threads at once, and once it holds maxNumFonts fonts it
+    forgets the one which was used least recently.
+
+    Consecutive runs usually share a font, so a reader can keep a LastFont of
+    its own and pass it in. A call for the same font as the last one then
+    returns it without taking the cache's lock.
+*/
+class FontCache  : private DeletedAtShutdown
+{
+public:
+    FontCache();
+    ~FontCache();
+
+    /** The font which one caller was given last. It mustn't be shared between threads. */
+    class LastFont
+    {
+    public:
+        LastFont() {}
+
+    private:
+        friend class FontCache;
+
+        String family;
+        float height = 0;
+        int styleFlags = 0;
+        bool isPointHeight = false, isValid = false;
+        Font font;
+
+        JUCE_DECLARE_NON_COPYABLE (LastFont)
+    };
+
+    /** Returns Font (family, height, styleFlags). */
+    Font getFont (const String& family, float height, int styleFlags, LastFont* lastFont = nullptr);
+
+    /** Returns Font (family, 12.0f, styleFlags).withPointHeight (pointHeight). */
+    Font getFontWithPointHeight (const String& family, float pointHeight, int styleFlags, LastFont* lastFont = nullptr);
+
+    //==============================================================================
+    /** The calls which a LastFont answered never reach the cache, so they aren't counted. */
+    struct Statistics
+    {
+        int64 numHits = 0, numMisses = 0, numEvictions = 0;
+        int numFonts = 0;
+    };
+
+    Statistics getStatistics() const;
+    void resetStatistics();
+
+    /** The default is 256. Lowering it evicts fonts straight away. */
+    void setMaxNumFonts (int maxNumFonts);
+
+    void clear();
+
+    juce_DeclareSingleton (FontCache, false)
+
+private:
+    //==============================================================================
+    struct Entry
+    {
+        String family;
+        float height;
+        int styleFlags;
+        bool isPointHeight;
+        int64 hash;
+        int previous, next;     // in order of use, most recent first
+        Font font;
+
+        bool matches (const String& f, float h, int flags, bool isPoints, int64 keyHash) const noexcept
+        {
+            return hash == keyHash && styleFlags == flags && isPointHeight == isPoints
+                    && height == h && family == f;
+        }
+    };
+
+    Font getFont (const String& family, float height, int styleFlags, bool isPointHeight, LastFont*);
+    Font findOrCreateFont (const String& family, float height, int styleFlags, bool isPointHeight);
+
+    void addEntry (const Entry&);
+    void linkAsMostRecent (int index) noexcept;
+    void unlink (int index) noexcept;
+    void keepMostRecent (int numToKeep);
+
+    CriticalSection lock;
+    Array<Entry> entries;
+    HashMap<int64, int> entryIndexes;
+    int maxNumFonts = 256, mostRecent = -1, leastRecent = -1;
+    Statistics stats;
+
+    JUCE_DECLARE_NON_COPYABLE (FontCache)
+};
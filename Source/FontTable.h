@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    The distinct fonts of a document, each held once, for the writers and tables
+    which give each run an index into them instead of a whole Font.
+
+    Fonts are found by a hash of their family, height and style, so adding a run
+    costs the same however many fonts the document has. Consecutive runs very
+    often share a font, so that one is checked before anything is hashed.
+*/
+class FontTable
+{
+public:
+    FontTable() {}
+
+    /** Returns the font's index, adding it at the end if it isn't there yet. */
+    int findOrAdd (const Font& font)
+    {
+        if (isPositiveAndBelow (lastIndex, fonts.size()) && fonts.getReference (lastIndex) == font)
+            return lastIndex;
+
+        const int64 hash = getHash (font);
+        lastIndex = indexes.contains (hash) ? indexes[hash] : -1;
+
+        // the map only holds the first font with each hash, so a different font
+        // with the same hash has to be searched for
+        if (lastIndex >= 0 && fonts.getReference (lastIndex) != font)
+            lastIndex = fonts.indexOf (font);
+
+        if (lastIndex < 0)
+        {
+            lastIndex = fonts.size();
+            fonts.add (font);
+
+            if (! indexes.contains (hash))
+                indexes.set (hash, lastIndex);
+
+            // the HashMap doesn't grow its table by itself
+            if (indexes.size() > indexes.getNumSlots())
+                indexes.remapTable (indexes.size() * 2);
+        }
+
+        return lastIndex;
+    }
+
+    /** Empties the table, keeping the fonts array's memory. */
+    void clear()
+    {
+        fonts.clearQuick();
+        indexes.clear();
+        lastIndex = -1;
+    }
+
+    int size() const noexcept                               { return fonts.size(); }
+    const Font& getReference (int index) const noexcept     { return fonts.getReference (index); }
+
+    const Font* begin() const noexcept                      { return fonts.begin(); }
+    const Font* end() const noexcept                        { return fonts.end(); }
+
+private:
+    static int64 getHash (const Font& font)
+    {
+        const float height = font.getHeight();
+        uint32 heightBits;
+        memcpy (&heightBits, &height, sizeof (heightBits));
+
+        return font.getTypefaceName().hashCode64() ^ ((int64) heightBits << 8) ^ font.getStyleFlags();
+    }
+
+    Array<Font> fonts;
+    HashMap<int64, int> indexes;
+    int lastIndex = -1;
+
+    JUCE_DECLARE_NON_COPYABLE (FontTable)
+};
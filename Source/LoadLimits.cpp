@@ -0,0 +1,82 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "LoadLimits.h"
+#include "AttributedStringBuilder.h"
+
+LoadLimits LoadLimits::forUntrustedInput() noexcept
+{
+    LoadLimits limits;
+    limits.maxInputBytes    = 64 * 1024 * 1024;
+    limits.maxDepth         = 256;
+    limits.maxNumAttributes = 1000000;
+    limits.maxTextBytes     = 64 * 1024 * 1024;
+    limits.maxSeconds       = 10.0;
+    return limits;
+}
+
+String LoadLimits::getErrorMessage() const
+{
+    switch (exceeded)
+    {
+        case Limit::inputBytes:     return "The document is larger than " + File::descriptionOfSizeInBytes (maxInputBytes);
+        case Limit::depth:          return "The document is nested more than " + String (maxDepth) + " levels deep";
+        case Limit::numAttributes:  return "The document has more than " + String (maxNumAttributes) + " differently formatted runs";
+        case Limit::textBytes:      return "The document's text is longer than " + File::descriptionOfSizeInBytes (maxTextBytes);
+        case Limit::time:           return "The document took longer than " + String (maxSeconds, 1) + " seconds to load";
+        case Limit::none:
+        default:                    return {};
+    }
+}
+
+//==============================================================================
+void LoadLimits::loadStarted() noexcept
+{
+    exceeded = Limit::none;
+    startTicks = Time::getHighResolutionTicks();
+}
+
+bool LoadLimits::checkInputSize (int64 numBytes) noexcept
+{
+    return maxInputBytes <= 0 || numBytes <= maxInputBytes || fail (Limit::inputBytes);
+}
+
+bool LoadLimits::checkDepth (int depth) noexcept
+{
+    return maxDepth <= 0 || depth <= maxDepth || fail (Limit::depth);
+}
+
+bool LoadLimits::checkProgress (int64 numBytesConsumed, const AttributedStringBuilder& builder) noexcept
+{
+    return checkInputSize (numBytesConsumed) && checkRun (builder);
+}
+
+bool LoadLimits::checkRun (const AttributedStringBuilder& builder) noexcept
+{
+    if (! checkOutputSize (builder.getNumAttributes(), builder.getNumTextBytes()))
+        return false;
+
+    return maxSeconds <= 0
+            || Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks) <= maxSeconds
+            || fail (Limit::time);
+}
+
+bool LoadLimits::checkOutputSize (int64 numAttributes, int64 numTextBytes) noexcept
+{
+    if (maxNumAttributes > 0 && numAttributes > maxNumAttributes)
+        return fail (Limit::numAttributes);
+
+    return maxTextBytes <= 0 || numTextBytes <= maxTextBytes || fail (Limit::textBytes);
+}
+
+bool LoadLimits::fail (Limit limit) noexcept
+{
+    exceeded = limit;
+    return false;
+}
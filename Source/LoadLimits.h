@@ -0,0 +1,85 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+class AttributedStringBuilder;
+
+//==============================================================================
+/**
+    Limits on how much a loader will do for one document, for documents which
+    come from untrusted sources. A limit of 0 means there isn't one.
+
+    The input size is checked each time a streaming loader reads another chunk
+    of the stream, so a loader can go up to a chunk (64 KB of input) past it
+    before it stops. The number of attributes, the length of the text and the
+    time are checked as each run of text is added, and the nesting depth as
+    each group or element is opened.
+
+    When a limit is hit the loader stops and returns nullptr, and
+    getExceededLimit() says which limit it was, which tells it apart from a
+    document which is just malformed. As each load records this here, a
+    LoadLimits object can't be used by two loads at the same time: give each
+    one its own copy.
+*/
+class LoadLimits
+{
+public:
+    LoadLimits() noexcept {}
+
+    /** Generous enough for any real document, and small enough to keep a
+        shared worker from being tied up for long.
+    */
+    static LoadLimits forUntrustedInput() noexcept;
+
+    int64 maxInputBytes = 0;            // after decompressing, if it was compressed
+    int maxDepth = 0;                   // RTF groups or XML elements
+    int maxNumAttributes = 0;
+    int64 maxTextBytes = 0;             // as UTF-8
+    double maxSeconds = 0;
+
+    //==============================================================================
+    enum class Limit
+    {
+        none,
+        inputBytes,
+        depth,
+        numAttributes,
+        textBytes,
+        time
+    };
+
+    /** The limit which stopped the last load, or Limit::none. */
+    Limit getExceededLimit() const noexcept         { return exceeded; }
+    bool wasExceeded() const noexcept               { return exceeded != Limit::none; }
+
+    /** Describes the limit which was hit, or returns an empty string. */
+    String getErrorMessage() const;
+
+    //==============================================================================
+    /** Called by the loaders when they start. This resets the exceeded limit and
+        starts the clock.
+    */
+    void loadStarted() noexcept;
+
+    /** These return false, and record the limit, if a limit has been exceeded. */
+    bool checkInputSize (int64 numBytes) noexcept;
+    bool checkDepth (int depth) noexcept;
+    bool checkProgress (int64 numBytesConsumed, const AttributedStringBuilder& builder) noexcept;
+    bool checkRun (const AttributedStringBuilder& builder) noexcept;
+    bool checkOutputSize (int64 numAttributes, int64 numTextBytes) noexcept;
+
+private:
+    bool fail (Limit limit) noexcept;
+
+    Limit exceeded = Limit::none;
+    int64 startTicks = 0;
+};
@@ -0,0 +1,37 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "AttributedStringBuilder.h"
+
+//==============================================================================
+/**
+    Lets the streaming loaders report how far they have got, and lets the caller
+    stop them early.
+
+    update() is called on the loading thread each time the loader is about to
+    read another chunk of the stream. If it returns false the loader stops
+    reading and returns nullptr.
+*/
+class LoadProgress
+{
+public:
+    virtual ~LoadProgress() {}
+
+    /** The builder holds the runs parsed so far: see AttributedStringBuilder::createSnapshot(). */
+    virtual bool update (int64 numBytesConsumed, const AttributedStringBuilder& partialResult) = 0;
+
+    /** If this returns a writer, the streaming loaders hand it each run as soon as
+        it's complete, on the loading thread, instead of adding the run to the
+        result, so a successful load returns an empty string. The binary loader
+        doesn't stream, and still fills in the result.
+    */
+    virtual AttributedRunWriter* getRunWriter()     { return nullptr; }
+};
@@ -8,6 +8,8 @@
   ==============================================================================
 */
 #include "AttributedStringSerializer.h"
+#include "DocumentLoader.h"
+#include "DocumentView.h"
 
 //==============================================================================
 class RtfFileLoaderApplication  : public JUCEApplication
@@ -59,66 +61,9 @@ public:
     {
     public:
 
-        class MainContentComponent : public Component, private Button::Listener
+        class MainContentComponent : public Component, private Button::Listener,
+                                     private DocumentLoader::Listener
         {
-        private:
-            //==============================================================================
-            //==============================================================================
-            //==============================================================================
-            class TextComponent : public Component, private ComponentListener
-            {
-            public:
-                TextComponent ()
-                {
-                    setOpaque (true);
-                    setSize (1, 1);
-
-                    parentHierarchyChanged();
-                }
-
-                void setText (const AttributedString& attr)
-                {
-                    layout.createLayout (attr, getWidth());
-                    setSize (getWidth(), layout.getHeight());
-
-                    repaint();
-                }
-
-                void paint (Graphics& g) override
-                {
-                    g.fillAll (Colours::white);
-                    layout.draw (g, getLocalBounds().toFloat());
-                }
-
-            private:
-                void parentHierarchyChanged() override
-                {
-                    Viewport* newParent = findParentComponentOfClass <Viewport> ();
-                    if (newParent != parent)
-                    {
-                        if (parent != nullptr)
-                            parent->removeComponentListener (this);
-
-                        parent = newParent;
-
-                        if (parent != nullptr)
-                        {
-                            parent->addComponentListener (this);
-                            componentMovedOrResized (*parent, false, true);
-                        }
-                    }
-                }
-
-                void componentMovedOrResized (Component&, bool, bool wasResized) override
-                {
-                    if (wasResized && parent != nullptr)
-                        setSize (parent->getWidth(), getHeight());
-                }
-
-                Viewport* parent = nullptr;
-                TextLayout layout;
-            };
-
         public:
 
             //==============================================================================
@@ -128,23 +73,21 @@ public:
             {
                 setOpaque (true);
 
-                viewport.setViewedComponent (&text, false);
-
                 load.addListener (this);
                 save.addListener (this);
 
                 save.setEnabled (false);
 
-               #if (JUCE_MAC || JUCE_IOS)
                 loadFromRtf.addListener (this);
-               #endif
+                cancel.addListener (this);
+
+                cancel.setEnabled (false);
 
                 addAndMakeVisible (load);
                 addAndMakeVisible (save);
-
-               #if (JUCE_MAC || JUCE_IOS)
                 addAndMakeVisible (loadFromRtf);
-               #endif
+                addAndMakeVisible (cancel);
+                addChildComponent (progressBar);
 
                 addAndMakeVisible (viewport);
 
@@ -157,20 +100,17 @@ public:
 
                 auto header = r.removeFromTop (40);
 
-               #if (JUCE_MAC || JUCE_IOS)
-                const int numHeaderButtons = 3;
-               #else
-                const int numHeaderButtons = 2;
-               #endif
+                const int numHeaderButtons = 4;
 
                 auto width = header.getWidth() / numHeaderButtons;
 
                 load.setBounds (header.removeFromLeft (width));
                 save.setBounds (header.removeFromLeft (width));
-
-               #if (JUCE_MAC || JUCE_IOS)
                 loadFromRtf.setBounds (header.removeFromLeft (width));
-               #endif
+                cancel.setBounds (header.removeFromLeft (width));
+
+                if (progressBar.isVisible())
+                    progressBar.setBounds (r.removeFromTop (20));
 
                 viewport.setBounds (r);
             }
@@ -188,15 +128,7 @@ public:
                     FileChooser fc ("Choose juce attributed string xml file");
 
                     if (fc.browseForFileToOpen ())
-                    {
-                        lastLoadedString = AttributedStringSerializer::createAttributedStringFromFile (fc.getResult());
-
-                        if (lastLoadedString != nullptr)
-                        {
-                            text.setText (*lastLoadedString);
-                            save.setEnabled (true);
-                        }
-                    }
+                        startLoading (fc.getResult(), DocumentLoader::Format::xmlOrBinary);
                 }
                 else if (btn == &save)
                 {
@@ -210,33 +142,70 @@ public:
                         AttributedStringSerializer::writeAttributedStringToFile (*lastLoadedString, fc.getResult());
                     }
                 }
-               #if (JUCE_MAC || JUCE_IOS)
                 else if (btn == &loadFromRtf)
                 {
                     FileChooser fc ("Choose .rtf file");
 
                     if (fc.browseForFileToOpen ())
-                    {
-                        lastLoadedString = AttributedStringSerializer::createAttributedStringFromRTFFile (fc.getResult());
-
-                        if (lastLoadedString != nullptr)
-                        {
-                            text.setText (*lastLoadedString);
-                            save.setEnabled (true);
-                        }
-                    }
+                        startLoading (fc.getResult(), DocumentLoader::Format::rtf);
                 }
-               #endif
+                else if (btn == &cancel)
+                {
+                    loader.cancel();
+                    loadingStopped();
+                }
+            }
+
+            //==============================================================================
+            void startLoading (const File& file, DocumentLoader::Format format)
+            {
+                loadProgress = 0.0;
+                loader.load (file, format);
+
+                save.setEnabled (false);
+                cancel.setEnabled (true);
+                progressBar.setVisible (true);
+                resized();
+            }
+
+            void loadingStopped()
+            {
+                // a failed or cancelled load leaves the previous document in place,
+                // so this replaces whatever preview was showing
+                viewport.setText (lastLoadedString != nullptr ? *lastLoadedString : AttributedString());
+
+                save.setEnabled (lastLoadedString != nullptr);
+                cancel.setEnabled (false);
+                progressBar.setVisible (false);
+                resized();
+            }
+
+            void documentPreviewAvailable (const AttributedString& firstPart) override
+            {
+                viewport.setText (firstPart);
+            }
+
+            void documentLoadProgressChanged (double progress) override
+            {
+                loadProgress = progress;
+            }
+
+            void documentLoaded (const File&, AttributedString* newDocument) override
+            {
+                if (newDocument != nullptr)
+                    lastLoadedString = newDocument;
+
+                loadingStopped();
             }
 
             //==============================================================================
-            TextButton load {"Load..."}, save {"Save..."};
-           #if (JUCE_MAC || JUCE_IOS)
-            TextButton loadFromRtf {"Load .rtf file..."};
-           #endif
-            Viewport viewport;
-            TextComponent text;
+            TextButton load {"Load..."}, save {"Save..."}, loadFromRtf {"Load .rtf file..."}, cancel {"Cancel"};
+            DocumentView viewport;
             ScopedPointer<AttributedString> lastLoadedString;
+
+            double loadProgress = 0.0;
+            ProgressBar progressBar { loadProgress };
+            DocumentLoader loader { *this };
         };
 
         MainWindow (String name)  : DocumentWindow (name,
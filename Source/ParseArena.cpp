@@ -0,0 +1,67 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "ParseArena.h"
+
+void* ParseArena::allocate (size_t numBytes)
+{
+    numBytes = (numBytes + (alignment - 1)) & ~(size_t) (alignment - 1);
+
+    // the blocks are only used in order, so a request which doesn't fit moves on for good
+    while (currentBlock < blocks.size())
+    {
+        Block& block = *blocks.getUnchecked (currentBlock);
+
+        if (numBytesUsed + numBytes <= block.size)
+        {
+            char* const p = block.data + numBytesUsed;
+            numBytesUsed += numBytes;
+            return p;
+        }
+
+        ++currentBlock;
+        numBytesUsed = 0;
+    }
+
+    Block& block = addBlock (jmax ((size_t) minBlockSize, numBytes));
+    currentBlock = blocks.size() - 1;
+    numBytesUsed = numBytes;
+    return block.data;
+}
+
+void ParseArena::reset()
+{
+    if (blocks.size() > 1)
+    {
+        const size_t total = getNumBytesReserved();
+        blocks.clear();
+        addBlock (total);
+    }
+
+    currentBlock = 0;
+    numBytesUsed = 0;
+}
+
+size_t ParseArena::getNumBytesReserved() const noexcept
+{
+    size_t total = 0;
+
+    for (auto* block : blocks)
+        total += block->size;
+
+    return total;
+}
+
+ParseArena::Block& ParseArena::addBlock (size_t size)
+{
+    Block* block = blocks.add (new Block());
+    block->data.malloc (size);
+    block->size = size;
+    return *block;
+}
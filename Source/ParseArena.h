@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    Memory for the buffers which a loader needs while it parses, kept from one
+    load to the next.
+
+    A thread which loads many documents, e.g. a converter's worker, can keep a
+    ParseArena and pass it to each of the loads. The loader takes its read
+    buffer and its text buffers from the arena instead of the heap, and resets
+    it when it starts, so once the arena has grown to fit the largest document
+    the loaders stop allocating memory for their own state. Nothing which is
+    handed out is freed before the next reset(), so a buffer which grows leaves
+    its old memory behind until then.
+
+    As each load resets it, an arena can't be used by two loads at the same
+    time: give each thread its own.
+*/
+class ParseArena
+{
+public:
+    ParseArena() noexcept {}
+
+    /** Returns memory for numBytes, aligned for any type, which stays valid until
+        the next reset().
+    */
+    void* allocate (size_t numBytes);
+
+    /** Makes all the memory which has been handed out available again. If the last
+        load needed more than one block, they're replaced by a single one which
+        is as large as all of them, so that the next load only needs that.
+    */
+    void reset();
+
+    /** The total size of the blocks it holds on to. */
+    size_t getNumBytesReserved() const noexcept;
+
+private:
+    struct Block
+    {
+        HeapBlock<char> data;
+        size_t size;
+    };
+
+    Block& addBlock (size_t size);
+
+    enum { minBlockSize = 128 * 1024, alignment = 16 };
+
+    OwnedArray<Block> blocks;
+    int currentBlock = 0;
+    size_t numBytesUsed = 0;    // in the current block
+
+    JUCE_DECLARE_NON_COPYABLE (ParseArena)
+};
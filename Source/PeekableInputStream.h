@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+//==============================================================================
+/**
+    Lets the loaders look at the first few bytes of a stream to find out which
+    format it's in, even if the stream can't go back.
+
+    The bytes which have been looked at are kept in a small buffer and are read
+    from there again before the rest of the source. The source must outlive
+    this object.
+*/
+class PeekableInputStream  : public InputStream
+{
+public:
+    PeekableInputStream (InputStream& sourceStream)  : source (sourceStream)
+    {
+    }
+
+    /** Reads up to numBytes from the start of the stream without consuming them,
+        and returns how many there are. This has to be called before read().
+    */
+    int peek (int numBytes)
+    {
+        jassert (pos == 0 && numBytes <= maxPeekSize);
+
+        while (numPeeked < numBytes)
+        {
+            const int num = source.read (peeked + numPeeked, numBytes - numPeeked);
+
+            if (num <= 0)
+                break;
+
+            numPeeked += num;
+        }
+
+        return jmin (numPeeked, numBytes);
+    }
+
+    const char* getPeekedData() const noexcept      { return peeked; }
+
+    //==============================================================================
+    int64 getTotalLength() override                 { return source.getTotalLength(); }
+    bool isExhausted() override                     { return pos == numPeeked && source.isExhausted(); }
+    int64 getPosition() override                    { return source.getPosition() - (numPeeked - pos); }
+
+    int read (void* destBuffer, int maxBytesToRead) override
+    {
+        int num = jmin (maxBytesToRead, numPeeked - pos);
+        memcpy (destBuffer, peeked + pos, (size_t) num);
+        pos += num;
+
+        if (num < maxBytesToRead)
+            num += jmax (0, source.read (static_cast<char*> (destBuffer) + num, maxBytesToRead - num));
+
+        return num;
+    }
+
+    bool setPosition (int64 newPosition) override
+    {
+        // the peeked bytes are only for the start: anything else goes to the source
+        pos = numPeeked;
+        return source.setPosition (newPosition);
+    }
+
+private:
+    enum { maxPeekSize = 16 };
+
+    InputStream& source;
+    char peeked[maxPeekSize];
+    int numPeeked = 0, pos = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (PeekableInputStream)
+};
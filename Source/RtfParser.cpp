@@ -0,0 +1,1828 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "RtfParser.h"
+#include "StreamByteReader.h"
+#include "Utf8Buffer.h"
+#include "AttributedStringBuilder.h"
+#include "FontCache.h"
+#include "LoadProgress.h"
+#include "LoadLimits.h"
+#include "TextTranscoding.h"
+#include "EmbeddedData.h"
+
+namespace
+{
+    //==============================================================================
+    enum class Keyword
+    {
+        unknown,
+
+        // special characters
+        par, line, tab, emdash, endash, emspace, enspace, qmspace,
+        bullet, lquote, rquote, ldblquote, rdblquote,
+
+        // character formatting
+        plain, b, i, ul, ulnone, f, fs, cf, uc, u,
+
+        // document level
+        deff, bin, ansi, ansicpg, mac, pc, pca,
+
+        // tables
+        fonttbl, fcharset, cpg, colortbl, red, green, blue,
+
+        // destinations which an AttributedString can't represent
+        skipDestination
+    };
+
+    struct KeywordEntry
+    {
+        const char* name;
+        Keyword keyword;
+    };
+
+    // must be kept sorted (by strcmp) for the binary search in findKeyword
+    const KeywordEntry keywordTable[] =
+    {
+        { "annotation",         Keyword::skipDestination },
+        { "ansi",               Keyword::ansi },
+        { "ansicpg",            Keyword::ansicpg },
+        { "atnauthor",          Keyword::skipDestination },
+        { "atnid",              Keyword::skipDestination },
+        { "author",             Keyword::skipDestination },
+        { "b",                  Keyword::b },
+        { "bin",                Keyword::bin },
+        { "bkmkend",            Keyword::skipDestination },
+        { "bkmkstart",          Keyword::skipDestination },
+        { "blue",               Keyword::blue },
+        { "bullet",             Keyword::bullet },
+        { "cell",               Keyword::tab },
+        { "cf",                 Keyword::cf },
+        { "colorschememapping", Keyword::skipDestination },
+        { "colortbl",           Keyword::colortbl },
+        { "comment",            Keyword::skipDestination },
+        { "cpg",                Keyword::cpg },
+        { "datastore",          Keyword::skipDestination },
+        { "deff",               Keyword::deff },
+        { "docvar",             Keyword::skipDestination },
+        { "emdash",             Keyword::emdash },
+        { "emspace",            Keyword::emspace },
+        { "endash",             Keyword::endash },
+        { "enspace",            Keyword::enspace },
+        { "f",                  Keyword::f },
+        { "fcharset",           Keyword::fcharset },
+        { "filetbl",            Keyword::skipDestination },
+        { "fldinst",            Keyword::skipDestination },
+        { "fonttbl",            Keyword::fonttbl },
+        { "footer",             Keyword::skipDestination },
+        { "footerf",            Keyword::skipDestination },
+        { "footerl",            Keyword::skipDestination },
+        { "footerr",            Keyword::skipDestination },
+        { "footnote",           Keyword::skipDestination },
+        { "fs",                 Keyword::fs },
+        { "generator",          Keyword::skipDestination },
+        { "green",              Keyword::green },
+        { "header",             Keyword::skipDestination },
+        { "headerf",            Keyword::skipDestination },
+        { "headerl",            Keyword::skipDestination },
+        { "headerr",            Keyword::skipDestination },
+        { "i",                  Keyword::i },
+        { "info",               Keyword::skipDestination },
+        { "latentstyles",       Keyword::skipDestination },
+        { "ldblquote",          Keyword::ldblquote },
+        { "line",               Keyword::line },
+        { "listoverridetable",  Keyword::skipDestination },
+        { "listtable",          Keyword::skipDestination },
+        { "listtext",           Keyword::skipDestination },
+        { "lquote",             Keyword::lquote },
+        { "mac",                Keyword::mac },
+        { "nonshppict",         Keyword::skipDestination },
+        { "object",             Keyword::skipDestination },
+        { "par",                Keyword::par },
+        { "pc",                 Keyword::pc },
+        { "pca",                Keyword::pca },
+        { "pict",               Keyword::skipDestination },
+        { "plain",              Keyword::plain },
+        { "pntext",             Keyword::skipDestination },
+        { "pntxta",             Keyword::skipDestination },
+        { "pntxtb",             Keyword::skipDestination },
+        { "qmspace",            Keyword::qmspace },
+        { "rdblquote",          Keyword::rdblquote },
+        { "red",                Keyword::red },
+        { "revtbl",             Keyword::skipDestination },
+        { "row",                Keyword::par },
+        { "rquote",             Keyword::rquote },
+        { "rsidtbl",            Keyword::skipDestination },
+        { "sect",               Keyword::par },
+        { "stylesheet",         Keyword::skipDestination },
+        { "tab",                Keyword::tab },
+        { "template",           Keyword::skipDestination },
+        { "themedata",          Keyword::skipDestination },
+        { "u",                  Keyword::u },
+        { "uc",                 Keyword::uc },
+        { "ul",                 Keyword::ul },
+        { "uld",                Keyword::ul },
+        { "uldash",             Keyword::ul },
+        { "uldb",               Keyword::ul },
+        { "ulnone",             Keyword::ulnone },
+        { "ulth",               Keyword::ul },
+        { "ulw",                Keyword::ul },
+        { "ulwave",             Keyword::ul },
+        { "xmlnstbl",           Keyword::skipDestination }
+    };
+
+    static Keyword findKeyword (const char* name) noexcept
+    {
+        int start = 0, end = numElementsInArray (keywordTable);
+
+        while (start < end)
+        {
+            const int mid = (start + end) / 2;
+            const int cmp = strcmp (name, keywordTable[mid].name);
+
+            if (cmp == 0)
+                return keywordTable[mid].keyword;
+
+            if (cmp < 0) end = mid;
+            else         start = mid + 1;
+        }
+
+        return Keyword::unknown;
+    }
+
+    // longer keywords are cut short, which is harmless as none of the ones we know are
+    enum { maxKeywordLength = 32 };
+
+    typedef TextTranscoding::CodePage CodePage;
+
+    //==============================================================================
+    static bool isLetter (int c) noexcept     { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+    static bool isDigit (int c) noexcept      { return c >= '0' && c <= '9'; }
+
+    static int hexDigitValue (int c) noexcept
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+
+        return -1;
+    }
+
+    //==============================================================================
+    // Cocoa writes PostScript names such as "ArialMT" or "Helvetica-Bold" into the
+    // font table and resolves them to a family and traits when reading the file.
+    // This approximates that without a font registry.
+    static void resolveFontName (const String& name, String& family, int& styleFlags)
+    {
+        String base (name.trim());
+        styleFlags = Font::plain;
+
+        if (base.isEmpty() || base.containsChar (' '))
+        {
+            family = base;
+            return;
+        }
+
+        const String suffix (base.fromFirstOccurrenceOf ("-", false, false).toLowerCase());
+        base = base.upToFirstOccurrenceOf ("-", false, false);
+
+        if (suffix.contains ("bold"))                                   styleFlags |= Font::bold;
+        if (suffix.contains ("italic") || suffix.contains ("oblique"))  styleFlags |= Font::italic;
+
+        if      (base.endsWith ("PSMT")) base = base.dropLastCharacters (4);
+        else if (base.endsWith ("MT"))   base = base.dropLastCharacters (2);
+
+        // "TimesNewRoman" -> "Times New Roman"
+        family.clear();
+        juce_wchar last = 0;
+
+        for (String::CharPointerType t (base.getCharPointer()); ! t.isEmpty();)
+        {
+            const juce_wchar c = t.getAndAdvance();
+
+            if (CharacterFunctions::isUpperCase (c) && CharacterFunctions::isLowerCase (last))
+                family += ' ';
+
+            family += c;
+            last = c;
+        }
+    }
+
+    //==============================================================================
+    enum class Destination
+    {
+        text,
+        fontTable,
+        colourTable,
+        skip
+    };
+
+    struct CharacterFormat
+    {
+        int fontNumber  = -1;       // -1 refers to the document's default font (\deff)
+        int halfPoints  = 24;
+        int colourIndex = 0;
+        int styleFlags  = Font::plain;
+
+        bool operator== (const CharacterFormat& other) const noexcept
+        {
+            return fontNumber == other.fontNumber && halfPoints == other.halfPoints
+                && colourIndex == other.colourIndex && styleFlags == other.styleFlags;
+        }
+
+        bool operator!= (const CharacterFormat& other) const noexcept   { return ! operator== (other); }
+    };
+
+    struct GroupState
+    {
+        CharacterFormat format;
+        Destination destination = Destination::text;
+        int unicodeSkip = 1;
+
+        bool operator== (const GroupState& other) const noexcept
+        {
+            return format == other.format && destination == other.destination && unicodeSkip == other.unicodeSkip;
+        }
+    };
+
+    struct FontTableEntry
+    {
+        int number;
+        String family;
+        int styleFlags;
+        int codePage;               // 0 if the font uses the document's code page
+
+        bool operator== (const FontTableEntry& other) const noexcept
+        {
+            return number == other.number && family == other.family && styleFlags == other.styleFlags
+                && codePage == other.codePage;
+        }
+    };
+
+    static void setStyle (CharacterFormat& format, int flag, bool shouldBeSet) noexcept
+    {
+        format.styleFlags = shouldBeSet ? (format.styleFlags | flag) : (format.styleFlags & ~flag);
+    }
+
+    // Applies the keywords which only change the state of the group they're in.
+    // Returns false for anything else, which the reader has to deal with itself.
+    static bool applyGroupKeyword (GroupState& group, Keyword keyword, bool hasParam, int param) noexcept
+    {
+        CharacterFormat& format = group.format;
+
+        switch (keyword)
+        {
+            case Keyword::plain:        format = CharacterFormat(); return true;
+            case Keyword::b:            setStyle (format, Font::bold,       ! hasParam || param != 0); return true;
+            case Keyword::i:            setStyle (format, Font::italic,     ! hasParam || param != 0); return true;
+            case Keyword::ul:           setStyle (format, Font::underlined, ! hasParam || param != 0); return true;
+            case Keyword::ulnone:       setStyle (format, Font::underlined, false); return true;
+            case Keyword::fs:           format.halfPoints = (hasParam && param > 0 ? param : 24); return true;
+            case Keyword::cf:           format.colourIndex = param; return true;
+            case Keyword::uc:           group.unicodeSkip = jmax (0, param); return true;
+
+            case Keyword::f:
+                // in the font table, \f starts a new entry
+                if (group.destination == Destination::fontTable)
+                    return false;
+
+                format.fontNumber = param;
+                return true;
+
+            case Keyword::fonttbl:          group.destination = Destination::fontTable; return true;
+            case Keyword::colortbl:         group.destination = Destination::colourTable; return true;
+            case Keyword::skipDestination:  group.destination = Destination::skip; return true;
+
+            default:
+                return false;
+        }
+    }
+
+    //==============================================================================
+    // Everything the reader carries from one byte of the document to the next,
+    // apart from the text of the current run. A parallel parse hands this over
+    // from one chunk of the document to the next.
+    struct ParserState
+    {
+        Array<GroupState> groups;
+        int pendingSkips = 0;
+        juce_wchar highSurrogate = 0;
+        int pendingLeadByte = 0;        // the first byte of a double-byte character
+
+        int codePage = 1252;            // \ansicpg
+
+        Array<FontTableEntry> fontTable;
+        int fontTableNumber = 0, defaultFontNumber = 0, fontTableCodePage = 0;
+
+        Array<Colour> colourTable;
+        int pendingRed = 0, pendingGreen = 0, pendingBlue = 0;
+        bool pendingColourIsSet = false;
+
+        bool operator== (const ParserState& other) const noexcept
+        {
+            return groups == other.groups && pendingSkips == other.pendingSkips && highSurrogate == other.highSurrogate
+                && pendingLeadByte == other.pendingLeadByte && codePage == other.codePage
+                && fontTable == other.fontTable && fontTableNumber == other.fontTableNumber
+                && defaultFontNumber == other.defaultFontNumber && fontTableCodePage == other.fontTableCodePage
+                && colourTable == other.colourTable
+                && pendingRed == other.pendingRed && pendingGreen == other.pendingGreen
+                && pendingBlue == other.pendingBlue && pendingColourIsSet == other.pendingColourIsSet;
+        }
+
+        bool operator!= (const ParserState& other) const noexcept   { return ! operator== (other); }
+    };
+
+    //==============================================================================
+    // The runs of one chunk of a parallel parse, merged as far as the builder would
+    // merge them. A run without a colour of its own inherits the colour of the run
+    // before it, which is only known here once a run in the chunk has had one.
+    struct RecordedRuns
+    {
+        struct Run
+        {
+            size_t numBytes;
+            Font font;
+            Colour colour;
+            bool hasColour;
+        };
+
+        void append (const char* utf8, size_t numBytes, const Font& font, const Colour* colour)
+        {
+            if (colour != nullptr)
+                lastColour = *colour;
+
+            const bool hasColour = (colour != nullptr || (! runs.isEmpty() && runs.getLast().hasColour));
+
+            text.append (utf8, numBytes);
+
+            if (! runs.isEmpty())
+            {
+                Run& last = runs.getReference (runs.size() - 1);
+
+                if (last.font == font && last.hasColour == hasColour && (! hasColour || last.colour == lastColour))
+                {
+                    last.numBytes += numBytes;
+                    return;
+                }
+            }
+
+            const Run run = { numBytes, font, lastColour, hasColour };
+            runs.add (run);
+        }
+
+        void appendTo (AttributedStringBuilder& builder, const Colour& inheritedColour) const
+        {
+            const char* utf8 = text.getData();
+
+            for (auto& run : runs)
+            {
+                builder.append (utf8, run.numBytes, &run.font, run.hasColour ? &run.colour : &inheritedColour);
+                utf8 += run.numBytes;
+            }
+        }
+
+        bool hasColour() const noexcept     { return ! runs.isEmpty() && runs.getLast().hasColour; }
+
+        void clear()
+        {
+            runs.clearQuick();
+            text.clear();
+            lastColour = Colour();
+        }
+
+        Array<Run> runs;
+        Utf8Buffer text;
+        Colour lastColour;
+    };
+
+    //==============================================================================
+    // Decodes the data of a picture, object or theme which the reader is skipping,
+    // and writes it to the stream which an EmbeddedDataHandler creates for it.
+    // The stream is only created once the data starts, by when the keywords which
+    // say what format a picture is in have been seen.
+    class EmbeddedItem
+    {
+    public:
+        EmbeddedItem (EmbeddedDataHandler& h, EmbeddedDataHandler::Kind k) noexcept
+            : handler (h), kind (k), extension (k == EmbeddedDataHandler::Kind::theme ? "zip" : "bin")
+        {
+        }
+
+        ~EmbeddedItem()
+        {
+            flush();
+        }
+
+        static bool isEmbeddedItem (const char* keyword, EmbeddedDataHandler::Kind& kind) noexcept
+        {
+            if (strcmp (keyword, "pict") == 0)       { kind = EmbeddedDataHandler::Kind::picture; return true; }
+            if (strcmp (keyword, "objdata") == 0)    { kind = EmbeddedDataHandler::Kind::object;  return true; }
+            if (strcmp (keyword, "themedata") == 0)  { kind = EmbeddedDataHandler::Kind::theme;   return true; }
+
+            return false;
+        }
+
+        void keywordFound (const char* keyword) noexcept
+        {
+            if (hasStarted || kind != EmbeddedDataHandler::Kind::picture)
+                return;
+
+            if      (strcmp (keyword, "pngblip") == 0)    extension = "png";
+            else if (strcmp (keyword, "jpegblip") == 0)   extension = "jpg";
+            else if (strcmp (keyword, "emfblip") == 0)    extension = "emf";
+            else if (strcmp (keyword, "wmetafile") == 0)  extension = "wmf";
+            else if (strcmp (keyword, "macpict") == 0)    extension = "pict";
+        }
+
+        // everything other than hex digits, i.e. whitespace, is ignored
+        void writeHex (const char* data, size_t numBytes)
+        {
+            for (size_t i = 0; i < numBytes; ++i)
+            {
+                const int digit = hexDigitValue (data[i]);
+
+                if (digit < 0)
+                    continue;
+
+                if (pendingNibble < 0)
+                {
+                    pendingNibble = digit;
+                    continue;
+                }
+
+                if (numBuffered == sizeof (buffer))
+                    flush();
+
+                buffer[numBuffered++] = (char) ((pendingNibble << 4) | digit);
+                pendingNibble = -1;
+            }
+        }
+
+        void writeBinary (const char* data, size_t numBytes)
+        {
+            flush();
+
+            if (OutputStream* out = getStream())
+                out->write (data, numBytes);
+        }
+
+    private:
+        void flush()
+        {
+            if (numBuffered > 0)
+                if (OutputStream* out = getStream())
+                    out->write (buffer, numBuffered);
+
+            numBuffered = 0;
+        }
+
+        OutputStream* getStream()
+        {
+            if (! hasStarted)
+            {
+                hasStarted = true;
+                stream = handler.createOutputStream (kind, extension);
+            }
+
+            return stream;
+        }
+
+        EmbeddedDataHandler& handler;
+        const EmbeddedDataHandler::Kind kind;
+        const char* extension;
+        ScopedPointer<OutputStream> stream;
+        bool hasStarted = false;
+        int pendingNibble = -1;
+        char buffer[4096];
+        size_t numBuffered = 0;
+
+        JUCE_DECLARE_NON_COPYABLE (EmbeddedItem)
+    };
+
+    //==============================================================================
+    class RtfReader  : private StreamByteReader::Listener
+    {
+    public:
+        RtfReader (InputStream& in, AttributedString& resultToFill, LoadProgress* progressToUse, LoadLimits* limitsToUse,
+                   EmbeddedDataHandler* embeddedDataToUse, ParseArena* arena)
+            : reader (in, 65536, arena), fontTableName (arena), result (resultToFill), builder (result, arena),
+              runText (arena), progress (progressToUse), limits (limitsToUse), embeddedData (embeddedDataToUse)
+        {
+            state.groups.ensureStorageAllocated (32);
+
+            if (progress != nullptr || limits != nullptr)
+                reader.setListener (this);
+
+            if (progress != nullptr)
+                builder.setRunWriter (progress->getRunWriter());
+        }
+
+        /** Creates a reader for one chunk of a parallel parse, which records its
+            runs instead of building an AttributedString.
+        */
+        RtfReader (InputStream& in, RecordedRuns& output)
+            : reader (in), result (unusedResult), builder (result), recordedRuns (&output),
+              progress (nullptr), limits (nullptr), embeddedData (nullptr)
+        {
+            state.groups.ensureStorageAllocated (32);
+        }
+
+        bool wasCancelled() const noexcept      { return reader.wasStopped(); }
+
+        bool parse()
+        {
+            if (! readHeader())
+                return false;
+
+            readContent();
+
+            flushRun();
+            builder.flush();
+            return true;
+        }
+
+        /** Parses a chunk which starts where the given state was left, or at the
+            start of the document if there's no state. Returns false if the
+            document doesn't start with an RTF header.
+        */
+        bool parseChunk (const ParserState* startState)
+        {
+            if (startState != nullptr)
+            {
+                state = *startState;
+                fontTableIndex.clear();
+                numIndexedFonts = 0;
+                textCodePage = nullptr;
+            }
+            else if (! readHeader())
+                return false;
+
+            readContent();
+            flushRun();
+            return true;
+        }
+
+        /** The state at the end of the chunk. It's only complete if no font table
+            entry has been left half-read.
+        */
+        const ParserState& getState() const noexcept        { return state; }
+        bool isStateComplete() const noexcept               { return fontTableName.isEmpty(); }
+        bool hasReachedEndOfDocument() const noexcept       { return reachedEndOfDocument; }
+
+    private:
+        bool aboutToReadChunk (int64 numBytesConsumed) override
+        {
+            if (limits != nullptr && ! limits->checkProgress (numBytesConsumed, builder))
+                return false;
+
+            return progress == nullptr || progress->update (numBytesConsumed, builder);
+        }
+
+        void readContent()
+        {
+            for (;;)
+            {
+                const int c = reader.next();
+
+                // a truncated document: keep what we have so far
+                if (c < 0)
+                    return;
+
+                switch (c)
+                {
+                    case '{':   pushGroup(); break;
+                    case '}':   if (! popGroup()) { reachedEndOfDocument = true; return; } break;
+                    case '\\':  readControl(); break;
+                    case '\r':
+                    case '\n':  break;
+                    default:    addTextByte (c); break;
+                }
+            }
+        }
+
+        //==============================================================================
+        bool readHeader()
+        {
+            int c;
+
+            do { c = reader.next(); } while (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+
+            if (c != '{' || reader.next() != '\\')
+                return false;
+
+            char name[maxKeywordLength];
+            bool hasParam;
+            int param;
+
+            if (! readKeyword (reader.next(), name, hasParam, param) || strcmp (name, "rtf") != 0)
+                return false;
+
+            // the root state sits below the document's group
+            state.groups.add (GroupState());
+            state.groups.add (GroupState());
+            return true;
+        }
+
+        GroupState& current() noexcept      { return state.groups.getReference (state.groups.size() - 1); }
+
+        void pushGroup()
+        {
+            // the root state and the document's group don't count
+            if (limits != nullptr && ! limits->checkDepth (state.groups.size() - 1))
+            {
+                reader.stop();
+                return;
+            }
+
+            state.groups.add (state.groups.getLast());
+            state.pendingSkips = 0;
+        }
+
+        bool popGroup()
+        {
+            if (current().destination == Destination::fontTable)
+                commitFontTableEntry();
+
+            state.groups.removeLast();
+            state.pendingSkips = 0;
+
+            // false once the document's own group has been closed
+            return state.groups.size() > 1;
+        }
+
+        //==============================================================================
+        void readControl()
+        {
+            const int c = reader.next();
+
+            if (isLetter (c))
+            {
+                char name[maxKeywordLength];
+                bool hasParam;
+                int param;
+
+                if (readKeyword (c, name, hasParam, param))
+                {
+                    handleKeyword (findKeyword (name), hasParam, param);
+
+                    if (current().destination == Destination::skip)
+                        skipDestination (name);
+                }
+
+                return;
+            }
+
+            switch (c)
+            {
+                case '\'':  readHexEscape(); break;
+                case '*':   current().destination = Destination::skip; break;
+                case '~':   addCharacter (0xa0); break;
+                case '_':   addCharacter (0x2011); break;
+                case '\r':
+                case '\n':  addCharacter ('\n'); break;
+                case '\\':
+                case '{':
+                case '}':   addCharacter ((juce_wchar) c); break;
+                default:    break;  // \- optional hyphen, \| \: index entries
+            }
+        }
+
+        bool readKeyword (int c, char* name, bool& hasParam, int& param)
+        {
+            if (! isLetter (c))
+                return false;
+
+            int len = 0;
+
+            do
+            {
+                if (len < maxKeywordLength - 1)
+                    name[len++] = (char) c;
+
+                c = reader.next();
+            }
+            while (isLetter (c));
+
+            name[len] = 0;
+
+            const bool negative = (c == '-');
+
+            if (negative)
+                c = reader.next();
+
+            int64 value = 0;
+            hasParam = false;
+
+            while (isDigit (c))
+            {
+                hasParam = true;
+
+                if (value < 0x7fffffff)
+                    value = value * 10 + (c - '0');
+
+                c = reader.next();
+            }
+
+            value = jmin (value, (int64) 0x7fffffff);
+            param = (int) (negative ? -value : value);
+
+            // a single space is part of the control word, anything else isn't
+            if (c >= 0 && c != ' ')
+                reader.pushBack();
+
+            return true;
+        }
+
+        void readHexEscape()
+        {
+            const int hi = hexDigitValue (reader.next());
+            const int lo = hexDigitValue (reader.next());
+
+            if (hi >= 0 && lo >= 0)
+                addCodePageByte ((uint8) ((hi << 4) | lo));
+        }
+
+        void handleKeyword (Keyword keyword, bool hasParam, int param)
+        {
+            GroupState& group = current();
+
+            if (applyGroupKeyword (group, keyword, hasParam, param))
+                return;
+
+            switch (keyword)
+            {
+                case Keyword::par:
+                case Keyword::line:         addCharacter ('\n'); break;
+                case Keyword::tab:          addCharacter ('\t'); break;
+                case Keyword::emdash:       addCharacter (0x2014); break;
+                case Keyword::endash:       addCharacter (0x2013); break;
+                case Keyword::emspace:      addCharacter (0x2003); break;
+                case Keyword::enspace:      addCharacter (0x2002); break;
+                case Keyword::qmspace:      addCharacter (0x2005); break;
+                case Keyword::bullet:       addCharacter (0x2022); break;
+                case Keyword::lquote:       addCharacter (0x2018); break;
+                case Keyword::rquote:       addCharacter (0x2019); break;
+                case Keyword::ldblquote:    addCharacter (0x201c); break;
+                case Keyword::rdblquote:    addCharacter (0x201d); break;
+                case Keyword::u:            addUnicodeCharacter (param); break;
+
+                case Keyword::f:
+                    // applyGroupKeyword leaves this to us only in the font table
+                    commitFontTableEntry();
+                    state.fontTableNumber = param;
+                    state.fontTableCodePage = 0;
+                    break;
+
+                case Keyword::fcharset:     setFontTableCodePage (group, CodePage::getNumberForCharset (param)); break;
+                case Keyword::cpg:          setFontTableCodePage (group, param); break;
+
+                case Keyword::ansi:         setCodePage (1252); break;
+                case Keyword::ansicpg:      setCodePage (param); break;
+                case Keyword::mac:          setCodePage (10000); break;
+                case Keyword::pc:           setCodePage (437); break;
+                case Keyword::pca:          setCodePage (850); break;
+
+                case Keyword::deff:         state.defaultFontNumber = param; break;
+                case Keyword::bin:          skipBytes (param); break;
+
+                case Keyword::red:          setColourComponent (group, state.pendingRed,   param); break;
+                case Keyword::green:        setColourComponent (group, state.pendingGreen, param); break;
+                case Keyword::blue:         setColourComponent (group, state.pendingBlue,  param); break;
+
+                case Keyword::unknown:
+                default:
+                    break;
+            }
+        }
+
+        void setColourComponent (const GroupState& group, int& component, int value) noexcept
+        {
+            if (group.destination == Destination::colourTable)
+            {
+                component = jlimit (0, 255, value);
+                state.pendingColourIsSet = true;
+            }
+        }
+
+        // skips the data of a \bin, passing it to the item if there is one
+        void skipBytes (int numBytes, EmbeddedItem* item = nullptr)
+        {
+            while (numBytes > 0)
+            {
+                if (reader.getNumBufferedBytes() == 0)
+                {
+                    if (reader.next() < 0)
+                        return;
+
+                    reader.pushBack();
+                }
+
+                const int num = jmin (numBytes, reader.getNumBufferedBytes());
+
+                if (item != nullptr)
+                    item->writeBinary (reader.getBufferedData(), (size_t) num);
+
+                reader.skipBufferedBytes (num);
+                numBytes -= num;
+            }
+        }
+
+        //==============================================================================
+        // Skips the rest of a group which the AttributedString has no use for,
+        // up to its closing brace. Pictures, objects and the like can be megabytes
+        // of hex, so this doesn't tokenise it: only braces, backslashes and \bin
+        // matter, and the bytes in between are passed over a buffer at a time.
+        // With an EmbeddedDataHandler, the data of the items found on the way is
+        // decoded and handed over.
+        void skipDestination (const char* keyword)
+        {
+            ScopedPointer<EmbeddedItem> item;
+            int depth = 1, itemDepth = 0, ignoredDepth = 0;
+
+            // the items which aren't at the start of the group
+            auto keywordFound = [&] (const char* name)
+            {
+                EmbeddedDataHandler::Kind kind;
+
+                if (item != nullptr)
+                {
+                    if (depth == itemDepth)
+                        item->keywordFound (name);
+                }
+                else if (ignoredDepth == 0)
+                {
+                    // the copy of a picture which Word writes for old readers
+                    if (strcmp (name, "nonshppict") == 0)
+                    {
+                        ignoredDepth = depth;
+                    }
+                    else if (EmbeddedItem::isEmbeddedItem (name, kind))
+                    {
+                        item = new EmbeddedItem (*embeddedData, kind);
+                        itemDepth = depth;
+                    }
+                }
+            };
+
+            if (embeddedData != nullptr)
+                keywordFound (keyword);
+
+            for (;;)
+            {
+                if (reader.getNumBufferedBytes() == 0)
+                {
+                    if (reader.next() < 0)
+                        return;
+
+                    reader.pushBack();
+                }
+
+                const char* const data = reader.getBufferedData();
+                const int num = (int) TextTranscoding::countUntilRtfDelimiter (data, (size_t) reader.getNumBufferedBytes());
+
+                if (item != nullptr && depth == itemDepth)
+                    item->writeHex (data, (size_t) num);
+
+                reader.skipBufferedBytes (num);
+
+                if (reader.getNumBufferedBytes() == 0)
+                    continue;
+
+                switch (reader.next())
+                {
+                    case '{':
+                        ++depth;
+                        break;
+
+                    case '}':
+                        if (depth == itemDepth)
+                        {
+                            item = nullptr;
+                            itemDepth = 0;
+                        }
+
+                        if (depth == ignoredDepth)
+                            ignoredDepth = 0;
+
+                        // the group's own closing brace is left to readContent
+                        if (--depth == 0)
+                        {
+                            reader.pushBack();
+                            return;
+                        }
+
+                        break;
+
+                    default:
+                    {
+                        // a backslash: only a control word needs reading, and an
+                        // escaped brace or backslash is passed over with it
+                        const int c = reader.next();
+
+                        char name[maxKeywordLength];
+                        bool hasParam;
+                        int param;
+
+                        if (! readKeyword (c, name, hasParam, param))
+                            break;
+
+                        if (strcmp (name, "bin") == 0)
+                            skipBytes (param, item != nullptr && depth == itemDepth ? item.get() : nullptr);
+                        else if (embeddedData != nullptr)
+                            keywordFound (name);
+
+                        break;
+                    }
+                }
+            }
+        }
+
+        //==============================================================================
+        void setCodePage (int number)
+        {
+            state.codePage = number;
+            textCodePage = nullptr;
+        }
+
+        void setFontTableCodePage (const GroupState& group, int number) noexcept
+        {
+            if (group.destination == Destination::fontTable)
+                state.fontTableCodePage = number;
+        }
+
+        // The code page of the text in a group: that of its font, or else the document's.
+        const CodePage& getCodePage (const GroupState& group)
+        {
+            if (group.destination == Destination::fontTable)
+                return findCodePage (state.fontTableCodePage != 0 ? state.fontTableCodePage : state.codePage);
+
+            const int fontNumber = (group.format.fontNumber >= 0 ? group.format.fontNumber : state.defaultFontNumber);
+
+            if (textCodePage == nullptr || fontNumber != textCodePageFontNumber)
+            {
+                const FontTableEntry* entry = findFontTableEntry (fontNumber);
+
+                textCodePage = &findCodePage (entry != nullptr && entry->codePage != 0 ? entry->codePage : state.codePage);
+                textCodePageFontNumber = fontNumber;
+            }
+
+            return *textCodePage;
+        }
+
+        static const CodePage& findCodePage (int number) noexcept
+        {
+            if (const CodePage* codePage = CodePage::find (number))
+                return *codePage;
+
+            return CodePage::getDefault();
+        }
+
+        //==============================================================================
+        // Returns the character of a \u, or 0 while it waits for the second half of a surrogate pair.
+        juce_wchar decodeUnicodeParameter (int param) noexcept
+        {
+            juce_wchar c = (juce_wchar) (param < 0 ? param + 65536 : param);
+
+            if (c >= 0xd800 && c < 0xdc00)
+            {
+                state.highSurrogate = c;
+                return 0;
+            }
+
+            if (c >= 0xdc00 && c < 0xe000)
+            {
+                if (state.highSurrogate != 0)
+                    c = 0x10000 + ((state.highSurrogate - 0xd800) << 10) + (c - 0xdc00);
+                else
+                    c = 0xfffd;
+            }
+
+            state.highSurrogate = 0;
+            return c;
+        }
+
+        void addUnicodeCharacter (int param)
+        {
+            const juce_wchar c = decodeUnicodeParameter (param);
+
+            if (c != 0)
+                addCharacter (c);
+
+            // the ANSI fallback which follows a \u is dropped
+            GroupState& group = current();
+            state.pendingSkips = group.unicodeSkip;
+
+            if (group.destination == Destination::text)
+                appendBufferedUnicode (group);
+        }
+
+        void addTextByte (int c)
+        {
+            if (c >= 0x80)
+            {
+                addCodePageByte ((uint8) c);
+                return;
+            }
+
+            if (state.pendingLeadByte != 0)
+            {
+                // the second byte of a double-byte character needn't be escaped
+                state.pendingLeadByte = 0;
+                addCharacter (0xfffd);
+                return;
+            }
+
+            GroupState& group = current();
+
+            if (group.destination == Destination::text && state.pendingSkips == 0)
+            {
+                startRun (group.format);
+                runText.appendByte ((char) c);
+                appendBufferedText (getCodePage (group));
+                return;
+            }
+
+            addCharacter ((juce_wchar) c);
+        }
+
+        // a byte of text in the current code page, whether escaped or not
+        void addCodePageByte (uint8 byte)
+        {
+            if (state.pendingSkips > 0)
+            {
+                --state.pendingSkips;
+                return;
+            }
+
+            GroupState& group = current();
+            const CodePage& codePage = getCodePage (group);
+
+            if (codePage.isDoubleByte())
+            {
+                if (state.pendingLeadByte != 0)
+                {
+                    state.pendingLeadByte = 0;
+                    addCharacter (0xfffd);
+                    return;
+                }
+
+                if (codePage.isLeadByte (byte))
+                {
+                    state.pendingLeadByte = byte;
+                    return;
+                }
+            }
+
+            if (group.destination == Destination::text)
+            {
+                startRun (group.format);
+                codePage.appendTo (runText, byte);
+                appendBufferedText (codePage);
+                return;
+            }
+
+            addCharacter (codePage.decode (byte));
+        }
+
+        //==============================================================================
+        // Copies as much text as it can straight out of the read buffer into the
+        // current run: plain ASCII, and the \'hh escapes and raw bytes of a
+        // single-byte code page, which is how most non-Latin text arrives. Anything
+        // else is left to the byte-by-byte path.
+        void appendBufferedText (const CodePage& codePage)
+        {
+            const char* const data = reader.getBufferedData();
+            const int available = reader.getNumBufferedBytes();
+            const bool isSingleByte = ! codePage.isDoubleByte();
+            int pos = 0;
+
+            while (pos < available)
+            {
+                const uint8 c = (uint8) data[pos];
+
+                if (c == '\\')
+                {
+                    if (! isSingleByte || pos + 3 >= available || data[pos + 1] != '\'')
+                        break;
+
+                    const int hi = hexDigitValue (data[pos + 2]);
+                    const int lo = hexDigitValue (data[pos + 3]);
+
+                    if (hi < 0 || lo < 0)
+                        break;
+
+                    codePage.appendTo (runText, (uint8) ((hi << 4) | lo));
+                    pos += 4;
+                }
+                else if (c >= 0x80)
+                {
+                    if (! isSingleByte)
+                        break;
+
+                    codePage.appendTo (runText, c);
+                    ++pos;
+                }
+                else if (c == '\r' || c == '\n')
+                {
+                    ++pos;
+                }
+                else if (c == '{' || c == '}')
+                {
+                    break;
+                }
+                else
+                {
+                    const int numPlain = (int) TextTranscoding::countPlainRtfText (data + pos, (size_t) (available - pos));
+                    runText.append (data + pos, (size_t) numPlain);
+                    pos += numPlain;
+                }
+            }
+
+            reader.skipBufferedBytes (pos);
+        }
+
+        // Decodes a sequence of \u escapes and their fallbacks straight out of the
+        // read buffer, as CJK text and text from Cocoa arrives. It stops at anything
+        // which isn't part of such a sequence, or which runs past the buffer.
+        void appendBufferedUnicode (const GroupState& group)
+        {
+            const char* const data = reader.getBufferedData();
+            const int available = reader.getNumBufferedBytes();
+            int pos = 0;
+
+            for (;;)
+            {
+                // the fallback: each \'hh or plain byte counts as one character
+                while (state.pendingSkips > 0 && pos < available)
+                {
+                    const char c = data[pos];
+
+                    if (c == '\r' || c == '\n')
+                    {
+                        ++pos;
+                        continue;
+                    }
+
+                    if (c == '{' || c == '}')
+                        break;
+
+                    if (c == '\\')
+                    {
+                        if (pos + 3 >= available || data[pos + 1] != '\''
+                             || hexDigitValue (data[pos + 2]) < 0 || hexDigitValue (data[pos + 3]) < 0)
+                            break;
+
+                        pos += 4;
+                    }
+                    else
+                    {
+                        ++pos;
+                    }
+
+                    --state.pendingSkips;
+                }
+
+                if (state.pendingSkips > 0 || pos + 2 >= available
+                     || data[pos] != '\\' || data[pos + 1] != 'u' || ! (isDigit (data[pos + 2]) || data[pos + 2] == '-'))
+                    break;
+
+                // the next \u, which needs to end before the buffer does
+                int end = pos + 2;
+                const bool negative = (data[end] == '-');
+
+                if (negative)
+                    ++end;
+
+                int64 value = 0;
+
+                while (end < available && isDigit (data[end]))
+                {
+                    if (value < 0x7fffffff)
+                        value = value * 10 + (data[end] - '0');
+
+                    ++end;
+                }
+
+                if (end >= available)
+                    break;
+
+                if (data[end] == ' ')
+                    ++end;
+
+                value = jmin (value, (int64) 0x7fffffff);
+                pos = end;
+
+                const juce_wchar c = decodeUnicodeParameter ((int) (negative ? -value : value));
+
+                if (c != 0)
+                {
+                    state.pendingLeadByte = 0;
+                    startRun (group.format);
+                    runText.appendCharacter (c);
+                }
+
+                state.pendingSkips = group.unicodeSkip;
+            }
+
+            reader.skipBufferedBytes (pos);
+        }
+
+        void addCharacter (juce_wchar c)
+        {
+            if (state.pendingSkips > 0)
+            {
+                --state.pendingSkips;
+                return;
+            }
+
+            // a double-byte character which was cut short is dropped
+            state.pendingLeadByte = 0;
+
+            GroupState& group = current();
+
+            switch (group.destination)
+            {
+                case Destination::text:
+                    startRun (group.format);
+                    runText.appendCharacter (c);
+                    break;
+
+                case Destination::fontTable:
+                    if (c == ';')       commitFontTableEntry();
+                    else if (c >= ' ')  fontTableName.appendCharacter (c);
+                    break;
+
+                case Destination::colourTable:
+                    if (c == ';')
+                        commitColourTableEntry();
+                    break;
+
+                case Destination::skip:
+                default:
+                    break;
+            }
+        }
+
+        //==============================================================================
+        void startRun (const CharacterFormat& format)
+        {
+            if (format != runFormat)
+            {
+                flushRun();
+                runFormat = format;
+            }
+        }
+
+        void flushRun()
+        {
+            if (runText.isEmpty())
+                return;
+
+            const int fontNumber = (runFormat.fontNumber >= 0 ? runFormat.fontNumber : state.defaultFontNumber);
+            const FontTableEntry* entry = findFontTableEntry (fontNumber);
+
+            const String& family = (entry != nullptr && entry->family.isNotEmpty() ? entry->family
+                                                                                   : Font::getDefaultSansSerifFontName());
+            const int styleFlags = runFormat.styleFlags | (entry != nullptr ? entry->styleFlags : 0);
+            const Font font (FontCache::getInstance()->getFontWithPointHeight (family, runFormat.halfPoints * 0.5f, styleFlags, &lastFont));
+
+            // formats which differ only in ways the AttributedString can't show
+            // (e.g. two colour indices for the same colour) are merged by the builder
+            const Colour* colour = nullptr;
+
+            if (isPositiveAndBelow (runFormat.colourIndex, state.colourTable.size())
+                 && state.colourTable.getReference (runFormat.colourIndex).getAlpha() != 0)
+                colour = &state.colourTable.getReference (runFormat.colourIndex);
+
+            if (recordedRuns != nullptr)
+                recordedRuns->append (runText.getData(), runText.getSize(), font, colour);
+            else
+                builder.append (runText.getData(), runText.getSize(), &font, colour);
+
+            runText.clear();
+
+            if (limits != nullptr && ! limits->checkRun (builder))
+                reader.stop();
+        }
+
+        const FontTableEntry* findFontTableEntry (int number)
+        {
+            // a hash of the table keeps a document with a huge font table linear
+            for (; numIndexedFonts < state.fontTable.size(); ++numIndexedFonts)
+            {
+                const int entryNumber = state.fontTable.getReference (numIndexedFonts).number;
+
+                if (! fontTableIndex.contains (entryNumber))
+                    fontTableIndex.set (entryNumber, numIndexedFonts);
+            }
+
+            // the HashMap doesn't grow its table by itself
+            if (fontTableIndex.size() > fontTableIndex.getNumSlots())
+                fontTableIndex.remapTable (fontTableIndex.size() * 2);
+
+            if (fontTableIndex.contains (number))
+                return &state.fontTable.getReference (fontTableIndex[number]);
+
+            return nullptr;
+        }
+
+        void commitFontTableEntry()
+        {
+            if (fontTableName.isEmpty())
+                return;
+
+            FontTableEntry entry;
+            entry.number = state.fontTableNumber;
+            entry.codePage = state.fontTableCodePage;
+            resolveFontName (fontTableName.toString(), entry.family, entry.styleFlags);
+
+            state.fontTable.add (entry);
+            fontTableName.clear();
+            state.fontTableCodePage = 0;
+            textCodePage = nullptr;
+        }
+
+        void commitColourTableEntry()
+        {
+            // an entry without components is the "auto" colour: leave the run's colour alone
+            state.colourTable.add (state.pendingColourIsSet ? Colour ((uint8) state.pendingRed, (uint8) state.pendingGreen,
+                                                                      (uint8) state.pendingBlue)
+                                                            : Colours::transparentBlack);
+
+            state.pendingRed = state.pendingGreen = state.pendingBlue = 0;
+            state.pendingColourIsSet = false;
+        }
+
+        //==============================================================================
+        StreamByteReader reader;
+
+        ParserState state;
+        HashMap<int, int> fontTableIndex;       // the first entry for each number
+        int numIndexedFonts = 0;
+        const CodePage* textCodePage = nullptr; // the code page of textCodePageFontNumber
+        int textCodePageFontNumber = 0;
+        Utf8Buffer fontTableName;
+        bool reachedEndOfDocument = false;
+
+        AttributedString unusedResult;      // a chunk of a parallel parse records its runs instead
+        AttributedString& result;
+        AttributedStringBuilder builder;
+        RecordedRuns* const recordedRuns = nullptr;
+        Utf8Buffer runText;
+        CharacterFormat runFormat;
+        FontCache::LastFont lastFont;
+
+        LoadProgress* const progress;
+        LoadLimits* const limits;
+        EmbeddedDataHandler* const embeddedData;
+
+        JUCE_DECLARE_NON_COPYABLE (RtfReader)
+    };
+
+    //==============================================================================
+    // Finds the places where a document in memory can be split for a parallel
+    // parse: paragraph breaks in the document's own group. This only looks at
+    // the braces and the control words, jumping over everything else with the
+    // same scan that the reader uses for skipped destinations, so it takes a
+    // small fraction of the time of a parse. It doesn't follow the formatting, so
+    // the state at each split has to be guessed: for each split it also finds an
+    // earlier paragraph break from which a worker can parse a few paragraphs to
+    // pick up the formatting, as most documents set it again often.
+    class SplitFinder
+    {
+    public:
+        struct Split
+        {
+            size_t offset, warmUpStart;     // warmUpStart is 0 if there isn't one
+        };
+
+        SplitFinder (const char* data, size_t numBytes) noexcept
+            : start (data), end (data + numBytes), p (data)
+        {
+        }
+
+        Array<Split> findSplits (size_t firstChunkSize, size_t chunkSize, size_t warmUpSize)
+        {
+            Array<Split> splits;
+            size_t nextSplit = firstChunkSize, warmUpStart = 0;
+            int depth = 0;
+
+            while (p < end)
+            {
+                p += TextTranscoding::countUntilRtfDelimiter (p, (size_t) (end - p));
+
+                if (p == end)
+                    break;
+
+                switch (*p++)
+                {
+                    case '{':
+                        ++depth;
+                        break;
+
+                    case '}':
+                        if (--depth <= 0)
+                            return splits;
+
+                        break;
+
+                    default:
+                        if (readControl() && depth == 1)
+                        {
+                            const size_t offset = (size_t) (p - start);
+
+                            if (offset >= nextSplit)
+                            {
+                                const Split split = { offset, warmUpStart };
+                                splits.add (split);
+                                nextSplit = offset + chunkSize;
+                                warmUpStart = offset;
+                            }
+                            else if (offset + warmUpSize <= nextSplit && ! splits.isEmpty())
+                            {
+                                warmUpStart = offset;
+                            }
+                        }
+
+                        break;
+                }
+            }
+
+            return splits;
+        }
+
+    private:
+        // returns true after a \par
+        bool readControl() noexcept
+        {
+            if (p == end)
+                return false;
+
+            if (! isLetter (*p))
+            {
+                // the reader always takes two bytes after \', whether they're hex or not
+                p += (*p == '\'' ? jmin ((ptrdiff_t) 3, end - p) : 1);
+                return false;
+            }
+
+            const char* const name = p;
+
+            while (p < end && isLetter (*p))
+                ++p;
+
+            const size_t nameLength = (size_t) (p - name);
+            const bool negative = (p < end && *p == '-');
+
+            if (negative)
+                ++p;
+
+            const char* const digits = p;
+            int64 value = 0;
+
+            while (p < end && isDigit (*p))
+            {
+                if (value < 0x7fffffff)
+                    value = value * 10 + (*p - '0');
+
+                ++p;
+            }
+
+            const bool hasParam = (p > digits);
+
+            if (p < end && *p == ' ')
+                ++p;
+
+            // the data after \bin can hold anything, braces included
+            if (nameLength == 3 && memcmp (name, "bin", 3) == 0)
+            {
+                if (! negative)
+                    p += jmin ((ptrdiff_t) value, end - p);
+
+                return false;
+            }
+
+            return nameLength == 3 && ! hasParam && memcmp (name, "par", 3) == 0;
+        }
+
+        const char* const start;
+        const char* const end;
+        const char* p;
+
+        JUCE_DECLARE_NON_COPYABLE (SplitFinder)
+    };
+
+    //==============================================================================
+    // chunks smaller than this aren't worth handing to another thread
+    const size_t minChunkSize = 256 * 1024;
+
+    // every other chunk needs the font and colour tables from the first one, so
+    // that one is parsed on its own before the rest, and is kept short
+    const size_t firstChunkSize = 64 * 1024;
+
+    // how much of the text before a chunk is parsed to guess the state it starts with
+    const size_t warmUpSize = 16 * 1024;
+
+    struct Chunk
+    {
+        size_t start, end, warmUpStart = 0;
+        ParserState startState, endState;
+        RecordedRuns runs;
+        bool isEndStateComplete = false, reachedEndOfDocument = false;
+
+        Colour inheritedColour;                 // for the runs before the chunk's first colour
+        ScopedPointer<AttributedString> text;   // the runs, once they've been built
+    };
+
+    static bool parseChunk (const char* data, Chunk& chunk, const ParserState* startState)
+    {
+        MemoryInputStream in (data + chunk.start, chunk.end - chunk.start, false);
+
+        chunk.runs.clear();
+        RtfReader reader (in, chunk.runs);
+
+        if (! reader.parseChunk (startState))
+            return false;
+
+        chunk.endState = reader.getState();
+        chunk.isEndStateComplete = reader.isStateComplete();
+        chunk.reachedEndOfDocument = reader.hasReachedEndOfDocument();
+        return true;
+    }
+
+    //==============================================================================
+    // One of the steps of a parallel parse, which is done for each of a number of
+    // items, e.g. chunks
+    struct ChunkTask
+    {
+        virtual ~ChunkTask() {}
+        virtual void run (int index) = 0;
+    };
+
+    class ChunkWorker  : public ThreadPoolJob
+    {
+    public:
+        ChunkWorker (ChunkTask& t, int numItemsToRun, Atomic<int>& n)
+            : ThreadPoolJob ("RTF chunk parser"), task (t), numItems (numItemsToRun), nextItem (n)
+        {
+        }
+
+        JobStatus runJob() override
+        {
+            for (;;)
+            {
+                const int index = (++nextItem) - 1;
+
+                if (index >= numItems)
+                    return jobHasFinished;
+
+                task.run (index);
+            }
+        }
+
+    private:
+        ChunkTask& task;
+        const int numItems;
+        Atomic<int>& nextItem;
+
+        JUCE_DECLARE_NON_COPYABLE (ChunkWorker)
+    };
+
+    // each thread keeps taking the next item until there are none left, so that a
+    // slow one doesn't hold up the rest
+    static void runOnThreads (ThreadPool& pool, int numThreads, int numItems, ChunkTask& task)
+    {
+        Atomic<int> nextItem;
+        OwnedArray<ChunkWorker> workers;
+
+        for (int i = 0; i < jmin (numThreads, numItems); ++i)
+            pool.addJob (workers.add (new ChunkWorker (task, numItems, nextItem)), false);
+
+        for (auto* worker : workers)
+            pool.waitForJobToFinish (worker, -1);
+    }
+
+    // Parses each chunk after the first, after parsing a few paragraphs before it
+    // to guess the state it starts with
+    struct ParseTask  : public ChunkTask
+    {
+        ParseTask (const char* d, OwnedArray<Chunk>& c) noexcept  : data (d), chunks (c) {}
+
+        void run (int index) override
+        {
+            Chunk& chunk = *chunks.getUnchecked (index + 1);
+
+            if (chunk.warmUpStart > 0)
+            {
+                Chunk warmUp;
+                warmUp.start = chunk.warmUpStart;
+                warmUp.end = chunk.start;
+
+                if (parseChunk (data, warmUp, &chunk.startState) && warmUp.isEndStateComplete)
+                    chunk.startState = warmUp.endState;
+            }
+
+            parseChunk (data, chunk, &chunk.startState);
+        }
+
+        const char* const data;
+        OwnedArray<Chunk>& chunks;
+    };
+
+    // Turns each chunk's runs into an AttributedString of its own
+    struct BuildTask  : public ChunkTask
+    {
+        BuildTask (OwnedArray<Chunk>& c) noexcept  : chunks (c) {}
+
+        void run (int index) override
+        {
+            Chunk& chunk = *chunks.getUnchecked (index);
+            chunk.text = new AttributedString();
+
+            AttributedStringBuilder builder (*chunk.text);
+            chunk.runs.appendTo (builder, chunk.inheritedColour);
+            builder.flush();
+            chunk.runs.clear();
+        }
+
+        OwnedArray<Chunk>& chunks;
+    };
+
+    // Appends each chunk's string to the one the given number of chunks before it,
+    // so that doubling that number each time joins them all in a few passes
+    struct JoinTask  : public ChunkTask
+    {
+        JoinTask (OwnedArray<Chunk>& c, int numChunksToJoin, int chunksApart) noexcept
+            : chunks (c), numChunks (numChunksToJoin), step (chunksApart)
+        {
+        }
+
+        void run (int index) override
+        {
+            const int first = index * 2 * step;
+
+            if (first + step < numChunks)
+            {
+                chunks.getUnchecked (first)->text->append (*chunks.getUnchecked (first + step)->text);
+                chunks.getUnchecked (first + step)->text = nullptr;
+            }
+        }
+
+        OwnedArray<Chunk>& chunks;
+        const int numChunks, step;
+    };
+}
+
+//==============================================================================
+AttributedString* RtfParser::parse (InputStream& stream, LoadProgress* progress, LoadLimits* limits,
+                                    EmbeddedDataHandler* embeddedData)
+{
+    ScopedPointer<AttributedString> result (new AttributedString);
+    return parse (stream, *result, progress, limits, embeddedData) ? result.release() : nullptr;
+}
+
+bool RtfParser::parse (InputStream& stream, AttributedString& result, LoadProgress* progress, LoadLimits* limits,
+                       EmbeddedDataHandler* embeddedData, ParseArena* arena)
+{
+    AttributedStringBuilder::resetTarget (result);
+
+    if (arena != nullptr)
+        arena->reset();
+
+    if (limits != nullptr)
+    {
+        limits->loadStarted();
+
+        const int64 totalLength = stream.getTotalLength();
+
+        if (totalLength >= 0 && ! limits->checkInputSize (totalLength - stream.getPosition()))
+            return false;
+    }
+
+    bool ok;
+
+    {
+        RtfReader reader (stream, result, progress, limits, embeddedData, arena);
+
+        // a cancelled load would otherwise look like a truncated document
+        ok = reader.parse() && ! reader.wasCancelled();
+    }
+
+    if (! ok)
+        AttributedStringBuilder::resetTarget (result);
+
+    return ok;
+}
+
+AttributedString* RtfParser::parseInParallel (const void* rtfData, size_t numBytes, int numThreads)
+{
+    const char* const data = static_cast<const char*> (rtfData);
+
+    // several chunks per thread, so that a slow one doesn't hold up the rest
+    const size_t chunkSize = jmax (minChunkSize, numBytes / (size_t) (4 * jmax (1, numThreads)));
+
+    Array<SplitFinder::Split> splits;
+
+    if (numThreads > 1 && numBytes >= 2 * minChunkSize)
+        splits = SplitFinder (data, numBytes).findSplits (firstChunkSize, chunkSize, warmUpSize);
+
+    if (splits.isEmpty())
+    {
+        MemoryInputStream in (data, numBytes, false);
+        return parse (in);
+    }
+
+    OwnedArray<Chunk> chunks;
+
+    for (int i = 0; i <= splits.size(); ++i)
+    {
+        Chunk* chunk = chunks.add (new Chunk());
+        chunk->start = (i > 0 ? splits.getReference (i - 1).offset : 0);
+        chunk->end   = (i < splits.size() ? splits.getReference (i).offset : numBytes);
+
+        if (i > 0)
+            chunk->warmUpStart = splits.getReference (i - 1).warmUpStart;
+    }
+
+    Chunk& first = *chunks.getFirst();
+
+    if (! parseChunk (data, first, nullptr))
+        return nullptr;
+
+    ThreadPool pool (numThreads);
+
+    if (! first.reachedEndOfDocument)
+    {
+        // the others start off with the first one's tables and formatting, and
+        // then parse a few paragraphs before their start to pick up the formatting
+        // there
+        for (int i = 1; i < chunks.size(); ++i)
+        {
+            ParserState& state = chunks.getUnchecked (i)->startState;
+            state = first.endState;
+
+            state.pendingSkips = 0;
+            state.highSurrogate = 0;
+            state.pendingLeadByte = 0;
+        }
+
+        ParseTask parseTask (data, chunks);
+        runOnThreads (pool, numThreads, chunks.size() - 1, parseTask);
+    }
+
+    // A run without a colour of its own takes the last colour before it, which
+    // may be in an earlier chunk
+    Colour lastColour (0xff000000);
+    int numChunks = 0;
+
+    while (numChunks < chunks.size())
+    {
+        Chunk& chunk = *chunks.getUnchecked (numChunks++);
+
+        if (numChunks > 1)
+        {
+            const Chunk& previous = *chunks.getUnchecked (numChunks - 2);
+
+            // half a font table entry can't be handed over, but that only
+            // happens with a font table outside of a group
+            if (! previous.isEndStateComplete)
+            {
+                MemoryInputStream in (data, numBytes, false);
+                return parse (in);
+            }
+
+            // the guess was wrong, e.g. because the formatting changed or a table
+            // came after the first chunk, so parse it again from where the one
+            // before really ended
+            if (chunk.startState != previous.endState)
+            {
+                chunk.startState = previous.endState;
+                parseChunk (data, chunk, &chunk.startState);
+            }
+        }
+
+        chunk.inheritedColour = lastColour;
+
+        if (chunk.runs.hasColour())
+            lastColour = chunk.runs.lastColour;
+
+        if (chunk.reachedEndOfDocument)
+            break;
+    }
+
+    BuildTask buildTask (chunks);
+    runOnThreads (pool, numThreads, numChunks, buildTask);
+
+    for (int step = 1; step < numChunks; step *= 2)
+    {
+        JoinTask joinTask (chunks, numChunks, step);
+        runOnThreads (pool, numThreads, (numChunks + 2 * step - 1) / (2 * step), joinTask);
+    }
+
+    return chunks.getFirst()->text.release();
+}
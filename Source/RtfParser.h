@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+class LoadProgress;
+class LoadLimits;
+class EmbeddedDataHandler;
+class ParseArena;
+
+//==============================================================================
+/**
+    A portable RTF reader.
+
+    The parser makes a single forward pass over the bytes of the stream and
+    builds an AttributedString with the fonts, sizes, styles and colours that the
+    Cocoa based importer would produce. Only character formatting which an
+    AttributedString can represent is honoured: paragraph formatting, pictures,
+    fields, headers and the document info are skipped.
+
+    Pictures, objects and the other destinations which are skipped are passed
+    over without being tokenised, and \bin data is jumped over by its length,
+    so documents full of images load at close to the speed of reading them.
+*/
+struct RtfParser
+{
+    /** Returns nullptr if the stream does not contain an RTF document, if the
+        LoadProgress cancels the load, or if the document exceeds the LoadLimits.
+        The pictures, objects and themes are handed to the EmbeddedDataHandler,
+        if there is one.
+    */
+    static AttributedString* parse (InputStream& stream, LoadProgress* progress = nullptr, LoadLimits* limits = nullptr,
+                                    EmbeddedDataHandler* embeddedData = nullptr);
+
+    /** Parses into an existing AttributedString, replacing what it held, and
+        returns false where the other version returns nullptr, leaving the string
+        empty. Buffers for the parse come from the arena, if there is one.
+    */
+    static bool parse (InputStream& stream, AttributedString& result, LoadProgress* progress = nullptr,
+                       LoadLimits* limits = nullptr, EmbeddedDataHandler* embeddedData = nullptr,
+                       ParseArena* arena = nullptr);
+
+    /** Parses a document which is already in memory on up to the given number of
+        threads. How much that gains depends on the document and on the machine,
+        so measure it with the rtf-load-parallel benchmarks before relying on it.
+
+        The document is split at the paragraph breaks of its outermost group, and
+        the pieces are parsed at the same time, each starting off with the tables
+        and the formatting which the first piece leaves behind. A piece which
+        turns out to have started with different formatting is parsed again once
+        the one before it is done, so the result is identical to what parse()
+        returns for the same data, but a document whose outermost group changes
+        its formatting from one paragraph to the next gains little. Small
+        documents are parsed on the calling thread.
+    */
+    static AttributedString* parseInParallel (const void* rtfData, size_t numBytes, int numThreads);
+};
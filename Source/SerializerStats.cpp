@@ -0,0 +1,150 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#include "SerializerStats.h"
+
+namespace
+{
+   #if ATTRIBUTED_STRING_STATS
+    ThreadLocalValue<SerializerStats*> currentStats;
+    ThreadLocalValue<SerializerStats> lastCallStats;
+
+    SpinLock totalsLock;
+    SerializerStats totals;
+
+    SerializerStats::AllocationCounter allocationCounter = nullptr;
+   #endif
+
+    static String formatBytes (int64 numBytes)
+    {
+        return String (numBytes / (1024.0 * 1024.0), 2) + " MB";
+    }
+}
+
+//==============================================================================
+double SerializerStats::getOtherSeconds() const noexcept
+{
+    double other = totalSeconds;
+
+    for (auto seconds : phaseSeconds)
+        other -= seconds;
+
+    return jmax (0.0, other);
+}
+
+SerializerStats& SerializerStats::operator+= (const SerializerStats& other) noexcept
+{
+    totalSeconds += other.totalSeconds;
+
+    for (int i = 0; i < numPhases; ++i)
+        phaseSeconds[i] += other.phaseSeconds[i];
+
+    numBytesRead         += other.numBytesRead;
+    numBytesWritten      += other.numBytesWritten;
+    numRunsAppended      += other.numRunsAppended;
+    numAttributesCreated += other.numAttributesCreated;
+    numFontsCreated      += other.numFontsCreated;
+    numFontCacheHits     += other.numFontCacheHits;
+    numAllocations       += other.numAllocations;
+    numCalls             += other.numCalls;
+    return *this;
+}
+
+String SerializerStats::toString() const
+{
+    auto ms = [] (double seconds) { return String (seconds * 1000.0, 2) + " ms"; };
+
+    return String (numCalls) + " calls, " + ms (totalSeconds)
+            + " (reading " + ms (phaseSeconds[readingInput])
+            + ", appending " + ms (phaseSeconds[appendingRuns])
+            + ", writing " + ms (phaseSeconds[writingOutput])
+            + ", Cocoa import " + ms (phaseSeconds[cocoaImport])
+            + ", other " + ms (getOtherSeconds()) + "), "
+            + formatBytes (numBytesRead) + " in, " + formatBytes (numBytesWritten) + " out, "
+            + String (numRunsAppended) + " runs into " + String (numAttributesCreated) + " attributes, "
+            + String (numFontsCreated) + " fonts created, " + String (numFontCacheHits) + " font cache hits, "
+            + String (numAllocations) + " allocations";
+}
+
+//==============================================================================
+#if ATTRIBUTED_STRING_STATS
+
+SerializerStats SerializerStats::getLastCall()
+{
+    return lastCallStats.get();
+}
+
+SerializerStats SerializerStats::getTotals()
+{
+    const SpinLock::ScopedLockType sl (totalsLock);
+    return totals;
+}
+
+void SerializerStats::resetTotals()
+{
+    const SpinLock::ScopedLockType sl (totalsLock);
+    totals = SerializerStats();
+}
+
+void SerializerStats::setAllocationCounter (AllocationCounter counter) noexcept
+{
+    allocationCounter = counter;
+}
+
+SerializerStats* SerializerStats::getCurrent() noexcept
+{
+    return currentStats.get();
+}
+
+//==============================================================================
+SerializerStats::ScopedCall::ScopedCall() noexcept
+    : isOutermost (currentStats.get() == nullptr)
+{
+    if (! isOutermost)
+        return;
+
+    currentStats = &stats;
+
+    if (allocationCounter != nullptr)
+        startAllocations = allocationCounter();
+
+    startTicks = Time::getHighResolutionTicks();
+}
+
+SerializerStats::ScopedCall::~ScopedCall()
+{
+    if (! isOutermost)
+        return;
+
+    stats.totalSeconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+
+    if (allocationCounter != nullptr)
+        stats.numAllocations = allocationCounter() - startAllocations;
+
+    stats.numCalls = 1;
+
+    currentStats = nullptr;
+    lastCallStats = stats;
+
+    const SpinLock::ScopedLockType sl (totalsLock);
+    totals += stats;
+}
+
+#else
+
+SerializerStats SerializerStats::getLastCall()                  { return {}; }
+SerializerStats SerializerStats::getTotals()                    { return {}; }
+void SerializerStats::resetTotals()                             {}
+void SerializerStats::setAllocationCounter (AllocationCounter) noexcept {}
+SerializerStats* SerializerStats::getCurrent() noexcept         { return nullptr; }
+
+SerializerStats::ScopedCall::ScopedCall() noexcept  : isOutermost (false) {}
+SerializerStats::ScopedCall::~ScopedCall() {}
+
+#endif
@@ -0,0 +1,134 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+/** Set this to 1 in the project's preprocessor definitions to make the loaders
+    and writers collect SerializerStats. When it's 0, the instrumentation isn't
+    compiled at all and the stats are always empty.
+*/
+#ifndef ATTRIBUTED_STRING_STATS
+ #define ATTRIBUTED_STRING_STATS 0
+#endif
+
+//==============================================================================
+/**
+    Where the time goes in the AttributedStringSerializer calls.
+
+    Each top-level call made on a thread collects its own stats, which can be
+    retrieved on that thread with getLastCall() once it has returned, and which
+    are also added to the totals of all calls since the last resetTotals().
+    Work done on other threads, like the chunks of a parallel RTF parse, isn't
+    included.
+*/
+struct SerializerStats
+{
+    enum Phase
+    {
+        readingInput,       // waiting for the input stream
+        appendingRuns,      // AttributedString::append()
+        writingOutput,      // the output stream's write()
+        cocoaImport,        // NSAttributedString's RTF import
+        numPhases
+    };
+
+    double totalSeconds = 0;
+    double phaseSeconds[numPhases] = {};
+
+    int64 numBytesRead = 0, numBytesWritten = 0;
+    int64 numRunsAppended = 0, numAttributesCreated = 0;
+    int64 numFontsCreated = 0, numFontCacheHits = 0;
+    int64 numAllocations = 0;       // only counted if there's an AllocationCounter
+    int numCalls = 0;
+
+    /** The time which isn't in any of the phases, i.e. parsing and formatting. */
+    double getOtherSeconds() const noexcept;
+
+    SerializerStats& operator+= (const SerializerStats& other) noexcept;
+
+    /** A one-line summary for logging. */
+    String toString() const;
+
+    //==============================================================================
+    static bool isEnabled() noexcept                { return ATTRIBUTED_STRING_STATS != 0; }
+
+    static SerializerStats getLastCall();
+    static SerializerStats getTotals();
+    static void resetTotals();
+
+    /** Allocations can only be counted by the application, e.g. by replacing
+        operator new. Set a function which returns the number made so far before
+        making any calls, and the stats will include the ones made during each.
+    */
+    typedef int64 (*AllocationCounter)();
+    static void setAllocationCounter (AllocationCounter counter) noexcept;
+
+    //==============================================================================
+    /** The stats of the call in progress on this thread, or nullptr. */
+    static SerializerStats* getCurrent() noexcept;
+
+    class ScopedCall;
+
+    class ScopedPhase
+    {
+    public:
+        ScopedPhase (Phase phaseToTime) noexcept
+            : stats (getCurrent()), phase (phaseToTime),
+              startTicks (stats != nullptr ? Time::getHighResolutionTicks() : 0)
+        {
+        }
+
+        ~ScopedPhase()
+        {
+            if (stats != nullptr)
+                stats->phaseSeconds[phase] += Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+        }
+
+    private:
+        SerializerStats* const stats;
+        const Phase phase;
+        const int64 startTicks;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedPhase)
+    };
+};
+
+//==============================================================================
+/** Collects the stats of a call, unless it is made from inside another one. */
+class SerializerStats::ScopedCall
+{
+public:
+    ScopedCall() noexcept;
+    ~ScopedCall();
+
+private:
+    SerializerStats stats;
+    const bool isOutermost;
+    int64 startTicks = 0, startAllocations = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (ScopedCall)
+};
+
+//==============================================================================
+#if ATTRIBUTED_STRING_STATS
+ #define ATTRIBUTED_STRING_STATS_CALL() \
+    const SerializerStats::ScopedCall JUCE_JOIN_MACRO (serializerStatsCall_, __LINE__)
+
+ #define ATTRIBUTED_STRING_STATS_PHASE(phase) \
+    const SerializerStats::ScopedPhase JUCE_JOIN_MACRO (serializerStatsPhase_, __LINE__) (SerializerStats::phase)
+
+ #define ATTRIBUTED_STRING_STATS_ADD(counter, amount) \
+    do { if (SerializerStats* const s_ = SerializerStats::getCurrent()) s_->counter += (amount); } while (false)
+#else
+ #define ATTRIBUTED_STRING_STATS_CALL()
+ #define ATTRIBUTED_STRING_STATS_PHASE(phase)
+ #define ATTRIBUTED_STRING_STATS_ADD(counter, amount)   do {} while (false)
+#endif
@@ -0,0 +1,115 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+#include "SerializerStats.h"
+#include "ParseArena.h"
+
+//==============================================================================
+/**
+    Reads an InputStream through a fixed size buffer, one byte at a time.
+
+    The readers never look further back than the byte they have just read, so
+    pushBack() is always satisfied from the buffer and the stream never needs to
+    be repositioned. Memory use is the size of the buffer, however long the
+    stream is, and the buffer can come from a ParseArena.
+*/
+class StreamByteReader
+{
+public:
+    StreamByteReader (InputStream& in, int bufferSizeToUse = 65536, ParseArena* arena = nullptr)
+        : stream (in), bufferSize (bufferSizeToUse)
+    {
+        if (arena != nullptr)
+        {
+            buffer = static_cast<char*> (arena->allocate ((size_t) bufferSize));
+        }
+        else
+        {
+            heapBuffer.malloc ((size_t) bufferSize);
+            buffer = heapBuffer;
+        }
+    }
+
+    /** Returns the next byte, or -1 at the end of the stream. */
+    int next()
+    {
+        if (pos == end && ! refill())
+            return -1;
+
+        return (uint8) buffer[pos++];
+    }
+
+    /** Un-reads the byte that next() has just returned. */
+    void pushBack() noexcept
+    {
+        jassert (pos > 0);
+        --pos;
+    }
+
+    /** The bytes which have been read from the stream but not consumed yet. */
+    const char* getBufferedData() const noexcept        { return buffer + pos; }
+    int getNumBufferedBytes() const noexcept            { return end - pos; }
+    void skipBufferedBytes (int num) noexcept           { jassert (num <= end - pos); pos += num; }
+
+    /** The position of the next byte relative to where the reader started. */
+    int64 getNumBytesConsumed() const noexcept          { return totalRead - (end - pos); }
+
+    //==============================================================================
+    /** Hears about each chunk before it is read, and can stop the reader. */
+    struct Listener
+    {
+        virtual ~Listener() {}
+
+        /** Returning false makes the reader behave as if the stream had ended. */
+        virtual bool aboutToReadChunk (int64 numBytesConsumed) = 0;
+    };
+
+    void setListener (Listener* newListener) noexcept   { listener = newListener; }
+
+    /** Makes the reader behave as if the stream had ended. */
+    void stop() noexcept                                { pos = end; stopped = true; }
+
+    /** True if the listener or stop() has stopped the reader. */
+    bool wasStopped() const noexcept                    { return stopped; }
+
+private:
+    bool refill()
+    {
+        pos = end = 0;
+
+        if (stopped || (listener != nullptr && ! listener->aboutToReadChunk (totalRead)))
+        {
+            stopped = true;
+            return false;
+        }
+
+        {
+            ATTRIBUTED_STRING_STATS_PHASE (readingInput);
+            end = jmax (0, stream.read (buffer, bufferSize));
+        }
+
+        ATTRIBUTED_STRING_STATS_ADD (numBytesRead, end);
+        totalRead += end;
+        return end > 0;
+    }
+
+    InputStream& stream;
+    const int bufferSize;
+    HeapBlock<char> heapBuffer;
+    char* buffer;
+    int pos = 0, end = 0;
+    int64 totalRead = 0;
+    Listener* listener = nullptr;
+    bool stopped = false;
+
+    JUCE_DECLARE_NON_COPYABLE (StreamByteReader)
+};
@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "Utf8Buffer.h"
+
+//==============================================================================
+/**
+    Converts text in the encodings which documents arrive in to the UTF-8 which
+    the builder takes, writing it straight into a Utf8Buffer, and finds the bytes
+    which the RTF reader has to look at.
+*/
+struct TextTranscoding
+{
+    //==============================================================================
+    /**
+        A legacy 8-bit code page, as selected by RTF's \ansicpg or a font's
+        \fcharset. Each byte is converted with a table which holds its UTF-8.
+
+        For the double-byte code pages (Japanese, Chinese and Korean) only the
+        lead bytes are known, so that a character's two bytes can be kept
+        together and replaced with U+FFFD. Writers put the Unicode of such text
+        in \u escapes in front of the bytes, which are then skipped.
+    */
+    class CodePage
+    {
+    public:
+        /** Returns the code page with a Windows code page number, or nullptr if it isn't one of ours. */
+        static const CodePage* find (int number) noexcept;
+
+        /** Windows-1252, which RTF assumes when a document doesn't say. */
+        static const CodePage& getDefault() noexcept;
+
+        /** Returns the code page number which an RTF \fcharset stands for, or 0 for
+            the charsets which use the document's own code page.
+        */
+        static int getNumberForCharset (int charset) noexcept;
+
+        int getNumber() const noexcept                      { return number; }
+        bool isDoubleByte() const noexcept                  { return leadBytes != nullptr; }
+        bool isLeadByte (uint8 byte) const noexcept         { return leadBytes != nullptr && leadBytes (byte); }
+
+        juce_wchar decode (uint8 byte) const noexcept       { return byte < 0x80 ? (juce_wchar) byte : (juce_wchar) upperHalf[byte - 0x80]; }
+
+        void appendTo (Utf8Buffer& buffer, uint8 byte) const
+        {
+            if (byte < 0x80)
+            {
+                buffer.appendByte ((char) byte);
+                return;
+            }
+
+            const Utf8Sequence& sequence = utf8[byte - 0x80];
+            buffer.append (sequence.bytes, sequence.length);
+        }
+
+    private:
+        typedef bool (*LeadByteTest) (uint8);
+
+        CodePage (int number, const uint16* upperHalf, LeadByteTest leadBytes = nullptr) noexcept;
+
+        struct Utf8Sequence
+        {
+            char bytes[3];
+            uint8 length;
+        };
+
+        int number;
+        const uint16* upperHalf;
+        LeadByteTest leadBytes;
+        Utf8Sequence utf8[128];
+    };
+
+    //==============================================================================
+    /** Returns how many bytes at the start of some RTF are plain text which can be
+        copied as it is: ASCII up to the first backslash, brace, CR or LF. This
+        classifies 16 bytes at a time with SSE2 or NEON where they're available.
+    */
+    static size_t countPlainRtfText (const char* data, size_t numBytes) noexcept;
+
+    /** Returns how many bytes come before the first backslash or brace, which is
+        all that matters in a destination which is being skipped.
+    */
+    static size_t countUntilRtfDelimiter (const char* data, size_t numBytes) noexcept;
+
+    /** Appends UTF-16 text, joining surrogate pairs. Unpaired surrogates become U+FFFD. */
+    static void appendUtf16 (Utf8Buffer& buffer, const uint16* utf16, size_t numUnits);
+};
@@ -0,0 +1,121 @@
+/*
+  ==============================================================================
+
+    JUCE Attributed String helper
+    Copyright 2017 ROLI Ltd.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ParseArena.h"
+
+//==============================================================================
+/**
+    A growable buffer of UTF-8 bytes which the readers use to collect the text of
+    a run. Appending never allocates unless the buffer needs to grow, and clear()
+    keeps the capacity so that the same buffer can be reused for every run.
+
+    Given a ParseArena, the buffer grows into memory from the arena rather than
+    the heap, and that memory belongs to the arena.
+*/
+class Utf8Buffer
+{
+public:
+    Utf8Buffer() noexcept {}
+    explicit Utf8Buffer (ParseArena* arenaToUse) noexcept  : arena (arenaToUse) {}
+
+    void clear() noexcept                       { size = 0; }
+    bool isEmpty() const noexcept               { return size == 0; }
+    size_t getSize() const noexcept             { return size; }
+    const char* getData() const noexcept        { return data; }
+
+    void appendByte (char c)
+    {
+        if (size == allocated)
+            grow (size + 1);
+
+        data[size++] = c;
+    }
+
+    void append (const char* src, size_t num)
+    {
+        if (size + num > allocated)
+            grow (size + num);
+
+        memcpy (data + size, src, num);
+        size += num;
+    }
+
+    void appendCharacter (juce_wchar c)
+    {
+        if (c < 0x80)
+        {
+            appendByte ((char) c);
+            return;
+        }
+
+        char bytes[4];
+        size_t num;
+
+        if (c < 0x800)
+        {
+            bytes[0] = (char) (0xc0 | (c >> 6));
+            bytes[1] = (char) (0x80 | (c & 0x3f));
+            num = 2;
+        }
+        else if (c < 0x10000)
+        {
+            bytes[0] = (char) (0xe0 | (c >> 12));
+            bytes[1] = (char) (0x80 | ((c >> 6) & 0x3f));
+            bytes[2] = (char) (0x80 | (c & 0x3f));
+            num = 3;
+        }
+        else
+        {
+            bytes[0] = (char) (0xf0 | (c >> 18));
+            bytes[1] = (char) (0x80 | ((c >> 12) & 0x3f));
+            bytes[2] = (char) (0x80 | ((c >> 6) & 0x3f));
+            bytes[3] = (char) (0x80 | (c & 0x3f));
+            num = 4;
+        }
+
+        append (bytes, num);
+    }
+
+    String toString() const
+    {
+        if (size == 0)
+            return {};
+
+        return String (CharPointer_UTF8 (data), CharPointer_UTF8 (data + size));
+    }
+
+private:
+    void grow (size_t minimumSize)
+    {
+        allocated = jmax ((size_t) 256, minimumSize, allocated * 2);
+
+        if (arena == nullptr)
+        {
+            heapData.realloc (allocated);
+            data = heapData;
+            return;
+        }
+
+        char* const newData = static_cast<char*> (arena->allocate (allocated));
+
+        if (size > 0)
+            memcpy (newData, data, size);
+
+        data = newData;
+    }
+
+    ParseArena* const arena = nullptr;
+    HeapBlock<char> heapData;
+    char* data = nullptr;
+    size_t size = 0, allocated = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (Utf8Buffer)
+};